@@ -0,0 +1,88 @@
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "OrderBook.h"
+
+// Time to pull every quote a client has in the book: one cancel per order against one mass cancel.
+// Other clients' orders rest on the same levels, so both versions leave the levels standing and only the
+// quoting client's orders are touched.
+
+namespace {
+  constexpr ClientId QUOTING_CLIENT = 1;
+  constexpr int QUOTE_LEVELS = 20;
+  constexpr Qty QUOTE_QTY = 10;
+
+  struct QuotedBook {
+    moodycamel::ConcurrentQueue<MarketData> queue;
+    OrderBook book;
+    std::vector<std::pair<OrderId, OrderHandle>> quotes;
+    OrderId nextClientOrderId = 1;
+
+    explicit QuotedBook(int quoteCount)
+        : queue(static_cast<std::size_t>(quoteCount) * 8), book(1, &queue, static_cast<std::size_t>(quoteCount) * 4) {
+      book.setDepthLevels(5);
+      for (int i = 0; i < 2 * QUOTE_LEVELS; ++i) {
+        book.addOrder(static_cast<ClientId>(2 + i), nextClientOrderId++, sideOf(i), priceOf(i), QUOTE_QTY);
+      }
+    }
+
+    static Side sideOf(int i) { return i % 2 ? Side::SELL : Side::BUY; }
+    static Price priceOf(int i) { return i % 2 ? 1001 + i / 2 % QUOTE_LEVELS : 1000 - i / 2 % QUOTE_LEVELS; }
+
+    /// Half the quotes bid, half offered, spread over QUOTE_LEVELS prices per side behind the other clients.
+    void quote(int quoteCount) {
+      quotes.clear();
+      for (int i = 0; i < quoteCount; ++i) {
+        const auto clientOrderId = nextClientOrderId++;
+        quotes.emplace_back(clientOrderId, book.addOrder(QUOTING_CLIENT, clientOrderId, sideOf(i), priceOf(i), QUOTE_QTY));
+      }
+    }
+
+    void drain() {
+      MarketData data;
+      while (queue.try_dequeue(data)) {}
+    }
+  };
+
+  void BM_CancelEachQuote(benchmark::State& state) {
+    const auto quoteCount = static_cast<int>(state.range(0));
+    QuotedBook quoted(quoteCount);
+    for (auto _ : state) {
+      state.PauseTiming();
+      quoted.quote(quoteCount);
+      quoted.drain();
+      state.ResumeTiming();
+
+      for (const auto& [clientOrderId, handle] : quoted.quotes) {
+        quoted.book.cancelOrder(QUOTING_CLIENT, clientOrderId, handle);
+      }
+
+      state.PauseTiming();
+      quoted.drain();
+      state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * quoteCount);
+  }
+
+  void BM_MassCancel(benchmark::State& state) {
+    const auto quoteCount = static_cast<int>(state.range(0));
+    QuotedBook quoted(quoteCount);
+    for (auto _ : state) {
+      state.PauseTiming();
+      quoted.quote(quoteCount);
+      quoted.drain();
+      state.ResumeTiming();
+
+      benchmark::DoNotOptimize(quoted.book.massCancel(QUOTING_CLIENT, true, true));
+
+      state.PauseTiming();
+      quoted.drain();
+      state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * quoteCount);
+  }
+}
+
+BENCHMARK(BM_CancelEachQuote)->Arg(1 << 8)->Arg(2000);
+BENCHMARK(BM_MassCancel)->Arg(1 << 8)->Arg(2000);
+
+BENCHMARK_MAIN();
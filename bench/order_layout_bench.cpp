@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "OrderBook.h"
+#include "Order.h"
+#include "perf_counter.h"
+
+// Cache misses per fill when walking a FIFO queue, before and after the hot/cold Order split.
+// Misses are only reported where perf_event_open is permitted; time per fill is always reported.
+
+namespace {
+  /// Order as laid out before the split, in the pool block that appended is_free_ to it (72 bytes, unaligned).
+  struct LegacyOrder {
+    ClientId clientId;
+    OrderId clientOrderId;
+    OrderId marketOrderId;
+    TickerId tickerId;
+    Side side;
+    Price price;
+    Qty quantity;
+    int priority;
+    LegacyOrder* prevOrder;
+    LegacyOrder* nextOrder;
+  };
+
+  struct LegacyBlock {
+    LegacyOrder object_;
+    bool is_free_ = true;
+  };
+
+  LegacyOrder& objectOf(LegacyBlock& block) { return block.object_; }
+  Order& objectOf(Order& order) { return order; }
+
+  constexpr std::size_t POOL_SPREAD = 4;            // the level's orders are interleaved with other levels' orders in the pool
+  constexpr std::size_t FLUSH_BYTES = 64 << 20;
+  constexpr Qty RESTING_QTY = 10;
+
+  void flushCaches(std::vector<char>& buffer) {
+    for (std::size_t i = 0; i < buffer.size(); i += CACHE_LINE_SIZE) {
+      buffer[i]++;
+    }
+    benchmark::ClobberMemory();
+  }
+
+  void reportFills(benchmark::State& state, const Bench::CacheMissCounter& counter, uint64_t misses, uint64_t fills) {
+    state.SetItemsProcessed(static_cast<int64_t>(fills));
+    if (counter.available() && fills > 0) {
+      state.counters["misses_per_fill"] = static_cast<double>(misses) / static_cast<double>(fills);
+    }
+  }
+
+  /// Walks one price level's FIFO queue the way matchOrder does: read quantity, fill, read the ids for the trade report.
+  template<typename Block>
+  void BM_FifoWalk(benchmark::State& state) {
+    using OrderT = std::remove_reference_t<decltype(objectOf(std::declval<Block&>()))>;
+    const auto queueLength = static_cast<std::size_t>(state.range(0));
+
+    std::vector<Block> pool(queueLength * POOL_SPREAD);
+    std::vector<std::size_t> slots(pool.size());
+    std::iota(slots.begin(), slots.end(), 0);
+    std::shuffle(slots.begin(), slots.end(), std::mt19937(42));
+
+    OrderT* head = nullptr;
+    OrderT* tail = nullptr;
+    for (std::size_t i = 0; i < queueLength; ++i) {
+      auto& order = objectOf(pool[slots[i]]);
+      order.clientId = static_cast<ClientId>(i % 64);
+      order.clientOrderId = i;
+      order.prevOrder = tail;
+      order.nextOrder = nullptr;
+      (tail ? tail->nextOrder : head) = &order;
+      tail = &order;
+    }
+
+    std::vector<char> flushBuffer(FLUSH_BYTES);
+    Bench::CacheMissCounter counter;
+    uint64_t misses = 0;
+    uint64_t fills = 0;
+    for (auto _ : state) {
+      state.PauseTiming();
+      for (auto order = head; order; order = order->nextOrder) {
+        order->quantity = RESTING_QTY;
+      }
+      flushCaches(flushBuffer);
+      state.ResumeTiming();
+
+      counter.start();
+      Qty remaining = static_cast<Qty>(queueLength) * RESTING_QTY;
+      uint64_t checksum = 0;
+      for (auto order = head; order && remaining > 0; order = order->nextOrder) {
+        const auto fillQty = std::min(remaining, order->quantity);
+        order->quantity -= fillQty;
+        remaining -= fillQty;
+        checksum += order->clientId + order->clientOrderId;
+      }
+      misses += counter.stop();
+      fills += queueLength;
+      benchmark::DoNotOptimize(checksum);
+    }
+    reportFills(state, counter, misses, fills);
+  }
+
+  /// One aggressive order sweeping a single level through the real OrderBook.
+  void BM_OrderBookSweep(benchmark::State& state) {
+    const auto restingOrders = static_cast<int>(state.range(0));
+    moodycamel::ConcurrentQueue<MarketData> queue(restingOrders * 4);
+    OrderBook book(1, &queue, static_cast<std::size_t>(restingOrders) * POOL_SPREAD);
+    MarketData data;
+    OrderId nextClientOrderId = 1;
+
+    std::vector<char> flushBuffer(FLUSH_BYTES);
+    Bench::CacheMissCounter counter;
+    uint64_t misses = 0;
+    uint64_t fills = 0;
+    for (auto _ : state) {
+      state.PauseTiming();
+      for (int i = 0; i < restingOrders; ++i) {
+        book.addOrder(static_cast<ClientId>(1 + i % 64), nextClientOrderId++, Side::SELL, 100, RESTING_QTY);
+      }
+      while (queue.try_dequeue(data)) {}
+      flushCaches(flushBuffer);
+      state.ResumeTiming();
+
+      counter.start();
+      book.addOrder(1000, nextClientOrderId++, Side::BUY, 100, restingOrders * RESTING_QTY);
+      misses += counter.stop();
+      fills += static_cast<uint64_t>(restingOrders);
+
+      state.PauseTiming();
+      while (queue.try_dequeue(data)) {}
+      state.ResumeTiming();
+    }
+    reportFills(state, counter, misses, fills);
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_FifoWalk, LegacyBlock)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 17);
+BENCHMARK_TEMPLATE(BM_FifoWalk, Order)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 17);
+BENCHMARK(BM_OrderBookSweep)->Arg(1 << 10)->Arg(1 << 14);
+
+BENCHMARK_MAIN();
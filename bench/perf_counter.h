@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Bench {
+  /// Hardware cache-miss counter for the calling thread (user space only).
+  /// perf_event_open is often unavailable in containers; available() is false then and read() returns 0.
+  class CacheMissCounter final {
+  public:
+    CacheMissCounter() {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~CacheMissCounter() {
+      if (fd_ >= 0) close(fd_);
+    }
+
+    bool available() const noexcept { return fd_ >= 0; }
+
+    void start() noexcept {
+      if (fd_ < 0) return;
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    uint64_t stop() noexcept {
+      if (fd_ < 0) return 0;
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t count = 0;
+      if (::read(fd_, &count, sizeof(count)) != sizeof(count)) return 0;
+      return count;
+    }
+
+    CacheMissCounter(const CacheMissCounter &) = delete;
+    CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+
+  private:
+    int fd_ = -1;
+  };
+}
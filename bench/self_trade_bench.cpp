@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+#include "OrderBook.h"
+
+// Time per fill of a sweep through one price level with and without self-trade prevention.
+// With distinct passive clients the prevention check must cost nothing measurable; with the aggressor's own
+// orders resting the cost of each prevented match is shown for comparison.
+
+namespace {
+  constexpr Qty RESTING_QTY = 10;
+  constexpr ClientId AGGRESSIVE_CLIENT = 1000;
+
+  /// One aggressive buy sweeping a level of restingOrders sells, all from other clients unless ownOrders is set.
+  void sweepLevel(benchmark::State& state, SelfTradePrevention mode, bool ownOrders) {
+    const auto restingOrders = static_cast<int>(state.range(0));
+    moodycamel::ConcurrentQueue<MarketData> queue(restingOrders * 4);
+    OrderBook book(1, &queue, static_cast<std::size_t>(restingOrders) * 2);
+    book.setSelfTradePrevention(mode);
+    MarketData data;
+    OrderId nextClientOrderId = 1;
+
+    for (auto _ : state) {
+      state.PauseTiming();
+      for (int i = 0; i < restingOrders; ++i) {
+        const ClientId clientId = ownOrders ? AGGRESSIVE_CLIENT : static_cast<ClientId>(1 + i % 64);
+        book.addOrder(clientId, nextClientOrderId++, Side::SELL, 100, RESTING_QTY);
+      }
+      while (queue.try_dequeue(data)) {}
+      state.ResumeTiming();
+
+      book.addOrder(AGGRESSIVE_CLIENT, nextClientOrderId++, Side::BUY, 100, restingOrders * RESTING_QTY,
+                    TimeInForce::IOC);
+
+      state.PauseTiming();
+      while (queue.try_dequeue(data)) {}
+      state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * restingOrders);
+  }
+
+  void BM_SweepNoPrevention(benchmark::State& state) {
+    sweepLevel(state, SelfTradePrevention::NONE, false);
+  }
+
+  void BM_SweepPreventionOtherClients(benchmark::State& state) {
+    sweepLevel(state, SelfTradePrevention::CANCEL_OLDEST, false);
+  }
+
+  void BM_SweepPreventionOwnOrders(benchmark::State& state) {
+    sweepLevel(state, SelfTradePrevention::CANCEL_OLDEST, true);
+  }
+}
+
+BENCHMARK(BM_SweepNoPrevention)->Arg(1 << 6)->Arg(1 << 10);
+BENCHMARK(BM_SweepPreventionOtherClients)->Arg(1 << 6)->Arg(1 << 10);
+BENCHMARK(BM_SweepPreventionOwnOrders)->Arg(1 << 6)->Arg(1 << 10);
+
+BENCHMARK_MAIN();
@@ -5,7 +5,10 @@
 #include "market_data.h"
 
 struct MarketData {
-    enum class Type { ADD, CANCEL, TRADE, BOOK_UPDATE, FLUSH };
+    enum class Type { ADD, CANCEL, TRADE, BOOK_UPDATE, FLUSH, MODIFY, DEPTH_UPDATE, STOP, AUCTION, REJECT };
+    /// L2 delta: NEW inserts a level at depthLevel and shifts deeper levels down, DELETE removes it and
+    /// shifts them up, CHANGE replaces its quantity. Consumers keep only the book's configured depth.
+    enum class DepthAction : char { NONE = '-', NEW = 'N', CHANGE = 'C', DELETE = 'D' };
     Type type;
     TickerId tickerId;
     ClientId aggressiveClientId;
@@ -16,6 +19,33 @@ struct MarketData {
     Price price;
     Qty quantity;
     std::string message;
+    DepthAction depthAction = DepthAction::NONE;   // DEPTH_UPDATE only
+    uint32_t depthLevel = 0;                        // DEPTH_UPDATE only, 0 is the best level
+    Price triggerPrice = 0;                         // STOP only; price is the limit, 0 for a stop-market order
+    // AUCTION records (message Open, Indicative or Uncross) carry the equilibrium price and executable
+    // volume in price and quantity, both 0 while nothing crosses, and the side with surplus volume in side.
+    // REJECT records come from the pre-trade checks, for orders that never reached a book: no ticker or
+    // sequence, and the message names the limit that was broken.
+
+    // Order-by-order (L3) detail. ADD carries the full order before it matches; TRADE then gives both sides'
+    // remaining quantity, and a limit order that still has quantity left once its message is done rests.
+    uint64_t sequence = 0;                  // per symbol, gap-free across every record its book publishes
+    OrderId aggressiveMarketOrderId = 0;    // exchange id of the order an ADD/CANCEL/MODIFY/TRADE refers to
+    OrderId passiveMarketOrderId = 0;       // TRADE only
+    Qty aggressiveRemaining = 0;            // open quantity left on that order after the event
+    Qty passiveRemaining = 0;               // TRADE only
+};
+
+/// What the credit monitor needs of a TRADE (or that a FLUSH happened), sent to it straight from the engine
+/// rather than through the market data queue and its publisher.
+struct FillRecord {
+    MarketData::Type type;      // TRADE or FLUSH
+    TickerId tickerId;
+    ClientId aggressiveClientId;
+    ClientId passiveClientId;
+    char side;                  // the aggressor's
+    Price price;
+    Qty quantity;
 };
 
 extern moodycamel::ConcurrentQueue<MarketData>* marketDataQueue;
\ No newline at end of file
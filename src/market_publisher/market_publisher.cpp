@@ -3,37 +3,18 @@
 #include <atomic>
 #include <thread>
 
-MarketPublisher::MarketPublisher(moodycamel::ConcurrentQueue<MarketData>* queue)
-    : marketDataQueue(queue), running(false) {}
+MarketPublisher::MarketPublisher(moodycamel::ConcurrentQueue<MarketData>* queue, FeedMode mode)
+    : marketDataQueue(queue), feedMode(mode), running(false) {}
 
 void MarketPublisher::run() {
     running = true;
     while (running) {
         MarketData data;
         if (marketDataQueue->try_dequeue(data)) {
-            switch (data.type) {
-                case MarketData::Type::ADD:
-                    LOG(info) << "A, " << data.aggressiveClientId << ", " << data.aggressiveOrderId
-                              << (!data.message.empty() ? " (" + data.message + ")" : "");
-                    break;
-                case MarketData::Type::CANCEL:
-                    LOG(info) << "C, " << data.aggressiveClientId << ", " << data.aggressiveOrderId;
-                    break;
-                case MarketData::Type::TRADE:
-                    LOG(info) << "T, " << data.aggressiveClientId << ", " << data.aggressiveOrderId << ", "
-                              << data.passiveClientId << ", " << data.passiveOrderId << ", "
-                              << data.price << ", " << data.quantity;
-                    break;
-                case MarketData::Type::BOOK_UPDATE:
-                    if (!data.message.empty()) {
-                        LOG(info) << data.message;
-                    } else {
-                        LOG(info) << "B, " << data.side << ", " << data.price << ", " << data.quantity;
-                    }
-                    break;
-                case MarketData::Type::FLUSH:
-                    LOG(info) << data.message;
-                    break;
+            if (feedMode == FeedMode::L3) {
+                publishL3(data);
+            } else {
+                publishClassic(data);
             }
         } else {
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
@@ -41,6 +22,100 @@ void MarketPublisher::run() {
     }
 }
 
+void MarketPublisher::publishClassic(const MarketData& data) {
+    switch (data.type) {
+        case MarketData::Type::ADD:
+            LOG(info) << "A, " << data.aggressiveClientId << ", " << data.aggressiveOrderId
+                      << (!data.message.empty() ? " (" + data.message + ")" : "");
+            break;
+        case MarketData::Type::CANCEL:
+            LOG(info) << "C, " << data.aggressiveClientId << ", " << data.aggressiveOrderId;
+            break;
+        case MarketData::Type::MODIFY:
+            LOG(info) << "R, " << data.aggressiveClientId << ", " << data.aggressiveOrderId << ", "
+                      << data.price << ", " << data.quantity
+                      << (!data.message.empty() ? " (" + data.message + ")" : "");
+            break;
+        case MarketData::Type::TRADE:
+            LOG(info) << "T, " << data.aggressiveClientId << ", " << data.aggressiveOrderId << ", "
+                      << data.passiveClientId << ", " << data.passiveOrderId << ", "
+                      << data.price << ", " << data.quantity;
+            break;
+        case MarketData::Type::BOOK_UPDATE:
+            if (!data.message.empty()) {
+                LOG(info) << data.message;
+            } else {
+                LOG(info) << "B, " << data.side << ", " << data.price << ", " << data.quantity;
+            }
+            break;
+        case MarketData::Type::STOP:
+            LOG(info) << "S, " << data.aggressiveClientId << ", " << data.aggressiveOrderId << ", "
+                      << data.triggerPrice << ", " << data.price << ", " << data.quantity
+                      << (!data.message.empty() ? " (" + data.message + ")" : "");
+            break;
+        case MarketData::Type::DEPTH_UPDATE:
+            LOG(info) << "L, " << data.side << ", " << static_cast<char>(data.depthAction) << ", "
+                      << data.depthLevel << ", " << data.price << ", " << data.quantity;
+            break;
+        case MarketData::Type::AUCTION:
+            LOG(info) << "I, " << data.side << ", " << data.price << ", " << data.quantity << " (" << data.message << ")";
+            break;
+        case MarketData::Type::REJECT:
+            LOG(info) << "X, " << data.aggressiveClientId << ", " << data.aggressiveOrderId << " (" << data.message << ")";
+            break;
+        case MarketData::Type::FLUSH:
+            LOG(info) << data.message;
+            break;
+    }
+}
+
+void MarketPublisher::publishL3(const MarketData& data) {
+    switch (data.type) {
+        case MarketData::Type::ADD:
+            LOG(info) << "A, " << data.tickerId << ", " << data.sequence << ", " << data.aggressiveMarketOrderId << ", "
+                      << data.side << ", " << data.price << ", " << data.aggressiveRemaining;
+            break;
+        case MarketData::Type::CANCEL:
+            LOG(info) << "C, " << data.tickerId << ", " << data.sequence << ", " << data.aggressiveMarketOrderId << ", "
+                      << data.side << ", " << data.price
+                      << (!data.message.empty() ? " (" + data.message + ")" : "");
+            break;
+        case MarketData::Type::MODIFY:
+            LOG(info) << "R, " << data.tickerId << ", " << data.sequence << ", " << data.aggressiveMarketOrderId << ", "
+                      << data.side << ", " << data.price << ", " << data.aggressiveRemaining
+                      << (!data.message.empty() ? " (" + data.message + ")" : "");
+            break;
+        case MarketData::Type::TRADE:
+            LOG(info) << "T, " << data.tickerId << ", " << data.sequence << ", " << data.aggressiveMarketOrderId << ", "
+                      << data.passiveMarketOrderId << ", " << data.price << ", " << data.quantity << ", "
+                      << data.aggressiveRemaining << ", " << data.passiveRemaining;
+            break;
+        case MarketData::Type::BOOK_UPDATE:
+            LOG(info) << "B, " << data.tickerId << ", " << data.sequence << ", " << data.side << ", "
+                      << data.price << ", " << data.quantity;
+            break;
+        case MarketData::Type::STOP:
+            LOG(info) << "S, " << data.tickerId << ", " << data.sequence << ", " << data.aggressiveMarketOrderId << ", "
+                      << data.side << ", " << data.triggerPrice << ", " << data.price << ", " << data.quantity
+                      << (!data.message.empty() ? " (" + data.message + ")" : "");
+            break;
+        case MarketData::Type::DEPTH_UPDATE:
+            LOG(info) << "L, " << data.tickerId << ", " << data.sequence << ", " << data.side << ", "
+                      << static_cast<char>(data.depthAction) << ", " << data.depthLevel << ", "
+                      << data.price << ", " << data.quantity;
+            break;
+        case MarketData::Type::AUCTION:
+            LOG(info) << "I, " << data.tickerId << ", " << data.sequence << ", " << data.side << ", "
+                      << data.price << ", " << data.quantity << " (" << data.message << ")";
+            break;
+        case MarketData::Type::FLUSH:
+            LOG(info) << data.message;
+            break;
+        case MarketData::Type::REJECT:
+            break;  // never reached a book, so not part of any symbol's sequence
+    }
+}
+
 void MarketPublisher::stop() {
     running = false;
 }
\ No newline at end of file
@@ -5,11 +5,19 @@
 
 class MarketPublisher {
 public:
-    MarketPublisher(moodycamel::ConcurrentQueue<MarketData>* queue);
+    /// CLASSIC is the client-id based feed; L3 publishes every record with its symbol sequence number and
+    /// exchange order ids, enough to keep an exact order-by-order book.
+    enum class FeedMode { CLASSIC, L3 };
+
+    MarketPublisher(moodycamel::ConcurrentQueue<MarketData>* queue, FeedMode mode = FeedMode::CLASSIC);
     void run();
     void stop();
 
 private:
     moodycamel::ConcurrentQueue<MarketData>* marketDataQueue;
+    FeedMode feedMode;
     bool running;
+
+    void publishClassic(const MarketData& data);
+    void publishL3(const MarketData& data);
 };
\ No newline at end of file
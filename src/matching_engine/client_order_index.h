@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include "Types.h"
+#include "Order.h"
+#include "robin_hood.h"
+
+/// Where a resting order lives: its book and its handle inside that book.
+struct OrderRef {
+    TickerId tickerId = 0;
+    OrderHandle handle;
+
+    bool valid() const { return handle.valid(); }
+};
+
+/// Maps (clientId, clientOrderId) to the order's location, with a separate id namespace per client.
+/// Each client gets its own table the first time it is seen. Ids inside a window starting at the client's
+/// first id are indexed directly, and the window slides forward as a monotonic client keeps numbering.
+/// Ids below the window, including orders still live when it slides past them, fall back to a small
+/// per-client hash map. Entries are only erased on cancel, expiry or a failed amend, not when an order fills,
+/// so each slide asks the caller which entries are still live and drops the rest, dense and sparse alike.
+/// A client whose window never slides is swept in idle time instead, once its hash map has doubled.
+class ClientOrderIndex {
+public:
+    static constexpr ClientId DIRECT_CLIENT_LIMIT = 1 << 16;    // client ids below this skip the client hash
+    static constexpr OrderId DENSE_WINDOW = 1 << 16;            // directly indexed ids per client
+    static constexpr std::size_t MIN_SWEEP_SIZE = 1024;         // hash fallback entries before a first sweep
+
+    OrderRef* find(ClientId clientId, OrderId clientOrderId) {
+        auto table = tableFor(clientId);
+        if (!table) {
+            return nullptr;
+        }
+        const OrderId offset = clientOrderId - table->base;
+        if (clientOrderId >= table->base && offset < table->dense.size()) {
+            auto& ref = table->dense[offset];
+            if (ref.valid()) {
+                return &ref;
+            }
+        }
+        if (table->sparse.empty()) {
+            return nullptr;
+        }
+        auto it = table->sparse.find(clientOrderId);
+        return it == table->sparse.end() ? nullptr : &it->second;
+    }
+
+    /// Record where an order rests; replaces any previous entry for the same id. isLive(const OrderRef&) says
+    /// whether an entry's order is still in its book; it is only called when the window slides.
+    template<typename IsLive>
+    void insert(ClientId clientId, OrderId clientOrderId, OrderRef ref, const IsLive& isLive) {
+        auto& table = tableOrCreate(clientId);
+        if (table.dense.empty() && table.sparse.empty()) {
+            table.base = clientOrderId;
+        }
+
+        if (clientOrderId >= table.base) {
+            OrderId offset = clientOrderId - table.base;
+            if (offset >= DENSE_WINDOW) {
+                slideWindow(table, clientOrderId + 1 - DENSE_WINDOW / 2, isLive);
+                queueSweepIfGrown(table);
+                offset = clientOrderId - table.base;
+            }
+            if (offset < DENSE_WINDOW) {
+                if (offset >= table.dense.size()) {
+                    table.dense.resize(std::min<OrderId>(std::max<OrderId>(offset + 1, table.dense.size() * 2), DENSE_WINDOW));
+                }
+                table.dense[offset] = ref;
+                if (!table.sparse.empty()) {
+                    table.sparse.erase(clientOrderId);
+                }
+                return;
+            }
+        }
+        table.sparse.insert_or_assign(clientOrderId, ref);
+        queueSweepIfGrown(table);
+    }
+
+    /// Drop the entries of filled orders from the hash fallback of one client queued by insert. Meant for the
+    /// engine's idle time; isLive is as for insert. Returns whether more clients are waiting.
+    template<typename IsLive>
+    bool sweep(const IsLive& isLive) {
+        if (sweepQueue.empty()) {
+            return false;
+        }
+        auto& table = tables[sweepQueue.back()];
+        sweepQueue.pop_back();
+        table.sweepQueued = false;
+        sweepSparse(table, isLive);
+        return !sweepQueue.empty();
+    }
+
+    /// Drop the entry found by find(); ref must point into this index.
+    void erase(ClientId clientId, OrderId clientOrderId, OrderRef* ref) {
+        auto table = tableFor(clientId);
+        const OrderId offset = clientOrderId - table->base;
+        if (clientOrderId >= table->base && offset < table->dense.size() && ref == &table->dense[offset]) {
+            *ref = OrderRef{};
+        } else {
+            table->sparse.erase(clientOrderId);
+        }
+    }
+
+    /// Forget every order; client tables keep their allocations for the next session.
+    void clear() {
+        for (auto& table : tables) {
+            table.dense.clear();
+            table.sparse.clear();
+            table.base = 0;
+            table.sweepAt = MIN_SWEEP_SIZE;
+            table.sweepQueued = false;
+        }
+        sweepQueue.clear();
+    }
+
+private:
+    struct ClientTable {
+        OrderId base = 0;
+        std::vector<OrderRef> dense;
+        robin_hood::unordered_flat_map<OrderId, OrderRef> sparse;
+        std::size_t sweepAt = MIN_SWEEP_SIZE;   // sparse size that queues the next sweep
+        bool sweepQueued = false;
+    };
+
+    static constexpr uint32_t NO_TABLE = UINT32_MAX;
+
+    std::vector<uint32_t> directSlots;
+    robin_hood::unordered_flat_map<ClientId, uint32_t> overflowSlots;
+    std::vector<ClientTable> tables;
+    std::vector<uint32_t> sweepQueue;   // tables whose hash fallback is due a sweep
+
+    ClientTable* tableFor(ClientId clientId) {
+        if (clientId < DIRECT_CLIENT_LIMIT) {
+            if (clientId >= directSlots.size() || directSlots[clientId] == NO_TABLE) {
+                return nullptr;
+            }
+            return &tables[directSlots[clientId]];
+        }
+        auto it = overflowSlots.find(clientId);
+        return it == overflowSlots.end() ? nullptr : &tables[it->second];
+    }
+
+    ClientTable& tableOrCreate(ClientId clientId) {
+        if (auto table = tableFor(clientId)) {
+            return *table;
+        }
+        const auto slot = static_cast<uint32_t>(tables.size());
+        tables.emplace_back();
+        if (clientId < DIRECT_CLIENT_LIMIT) {
+            if (clientId >= directSlots.size()) {
+                directSlots.resize(std::max<std::size_t>(clientId + 1, directSlots.size() * 2), NO_TABLE);
+            }
+            directSlots[clientId] = slot;
+        } else {
+            overflowSlots.emplace(clientId, slot);
+        }
+        return tables.back();
+    }
+
+    void queueSweepIfGrown(ClientTable& table) {
+        if (table.sparse.size() >= table.sweepAt && !table.sweepQueued) [[unlikely]] {
+            table.sweepQueued = true;
+            sweepQueue.push_back(static_cast<uint32_t>(&table - tables.data()));
+        }
+    }
+
+    /// Drop the fallback entries of orders that have left their book. The next sweep waits until the fallback
+    /// has doubled again, so each one is paid for by the inserts since the last.
+    template<typename IsLive>
+    static void sweepSparse(ClientTable& table, const IsLive& isLive) {
+        for (auto it = table.sparse.begin(); it != table.sparse.end();) {
+            it = isLive(it->second) ? std::next(it) : table.sparse.erase(it);
+        }
+        table.sweepAt = std::max(MIN_SWEEP_SIZE, table.sparse.size() * 2);
+    }
+
+    /// Move the dense window up to newBase. Orders still live below it move to the hash fallback; entries
+    /// of orders that have filled since they were indexed are dropped there, and from the fallback itself.
+    /// A slide happens at most once per DENSE_WINDOW / 2 inserts, which pays for the sweep of the fallback.
+    template<typename IsLive>
+    static void slideWindow(ClientTable& table, OrderId newBase, const IsLive& isLive) {
+        sweepSparse(table, isLive);
+        const OrderId shift = newBase - table.base;
+        const auto kept = shift < table.dense.size() ? table.dense.size() - shift : 0;
+        for (OrderId i = 0; i < std::min<OrderId>(shift, table.dense.size()); ++i) {
+            if (table.dense[i].valid() && isLive(table.dense[i])) {
+                table.sparse.insert_or_assign(table.base + i, table.dense[i]);
+            }
+        }
+        std::copy(table.dense.begin() + (table.dense.size() - kept), table.dense.end(), table.dense.begin());
+        std::fill(table.dense.begin() + kept, table.dense.end(), OrderRef{});
+        table.base = newBase;
+    }
+};
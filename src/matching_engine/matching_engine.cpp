@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <boost/container/flat_map.hpp>
 #include <robin_hood.h>
@@ -8,6 +9,11 @@
 #include "OrderBook.h"
 #include "Order.h"
 #include "message_parser.h"
+#include "client_order_index.h"
+#include "timer_wheel.h"
+#include "pre_trade_risk.h"
+#include "credit_risk.h"
+#include "time_utils.h"
 #include "logging_util.h"
 
 using namespace std::chrono;
@@ -34,17 +40,83 @@ using OrderBookMap = robin_hood::unordered_flat_map<Symbol, std::unique_ptr<Orde
 SymbolMap symbolToTickerId;
 TickerId nextTickerId = 1;
 OrderBookMap neworderBooks;
-robin_hood::unordered_flat_map<OrderId, Symbol> orderIdToSymbol;
+std::vector<OrderBook*> booksByTickerId;
+std::vector<ReferencePriceTable::Slot*> referenceSlotsByTickerId;   // where each book's reference price goes
+ClientOrderIndex orderIndex;
+FillFeed* fillFeed = nullptr;    // credit monitor's feed, when one runs
 int testCounter = 1;
 const size_t INITIAL_POOL_SIZE = 100000;
 const size_t PRE_ALLOCATED_ORDERBOOKS = 20;
+const size_t PRICE_BAND_TICKS = DEFAULT_PRICE_BAND_TICKS;
+const size_t DEFAULT_DEPTH_LEVELS = 0;   // the L2 feed is off unless a symbol opts in with setDepthLevels
+const size_t MAX_BATCH_SIZE = 64;    // messages taken from the parser queue per dequeue
+const size_t COMPACTION_BUDGET = 64;    // tombstones one idle pass of the engine loop may free
+const Common::Nanos EXPIRY_TICK = Common::NANOS_TO_MILLIS;    // resolution of good-till-date expiry
+
+/// A good-till-date order waiting for its expiry. The order may have left the book by then; the index
+/// entry and the handle's generation tell.
+struct ExpiryTimer {
+    TickerId tickerId = 0;
+    ClientId clientId = 0;
+    OrderId clientOrderId = 0;
+    OrderHandle handle;
+};
+
+TimerWheel<ExpiryTimer> expiryWheel;
 
 std::vector<std::unique_ptr<OrderBook>> orderBookPool;
+robin_hood::unordered_flat_map<Symbol, std::size_t, SymbolHash, SymbolEqual> depthLevelsBySymbol;
+robin_hood::unordered_flat_map<Symbol, SelfTradePrevention, SymbolHash, SymbolEqual> selfTradePreventionBySymbol;
+robin_hood::unordered_flat_map<Symbol, MatchingPolicy, SymbolHash, SymbolEqual> matchingPolicyBySymbol;
+robin_hood::unordered_flat_map<Symbol, bool, SymbolHash, SymbolEqual> lazyCancelsBySymbol;
+
+Symbol toSymbol(const std::string& name) {
+    Symbol symbol;
+    std::strncpy(symbol.data(), name.c_str(), symbol.size() - 1);
+    symbol[symbol.size() - 1] = '\0';
+    return symbol;
+}
+
+void setDepthLevels(const std::string& symbol, std::size_t levels) {
+    depthLevelsBySymbol[toSymbol(symbol)] = levels;
+}
+
+std::size_t depthLevelsFor(const Symbol& symbol) {
+    auto it = depthLevelsBySymbol.find(symbol);
+    return it == depthLevelsBySymbol.end() ? DEFAULT_DEPTH_LEVELS : it->second;
+}
+
+void setSelfTradePrevention(const std::string& symbol, SelfTradePrevention mode) {
+    selfTradePreventionBySymbol[toSymbol(symbol)] = mode;
+}
+
+SelfTradePrevention selfTradePreventionFor(const Symbol& symbol) {
+    auto it = selfTradePreventionBySymbol.find(symbol);
+    return it == selfTradePreventionBySymbol.end() ? SelfTradePrevention::NONE : it->second;
+}
+
+void setMatchingPolicy(const std::string& symbol, MatchingPolicy policy) {
+    matchingPolicyBySymbol[toSymbol(symbol)] = policy;
+}
+
+MatchingPolicy matchingPolicyFor(const Symbol& symbol) {
+    auto it = matchingPolicyBySymbol.find(symbol);
+    return it == matchingPolicyBySymbol.end() ? MatchingPolicy::FIFO : it->second;
+}
+
+void setLazyCancels(const std::string& symbol, bool enabled) {
+    lazyCancelsBySymbol[toSymbol(symbol)] = enabled;
+}
+
+bool lazyCancelsFor(const Symbol& symbol) {
+    auto it = lazyCancelsBySymbol.find(symbol);
+    return it != lazyCancelsBySymbol.end() && it->second;
+}
 
 void initializeOrderBookPool() {
     orderBookPool.reserve(PRE_ALLOCATED_ORDERBOOKS);
     for (size_t i = 0; i < PRE_ALLOCATED_ORDERBOOKS; ++i) {
-        orderBookPool.push_back(std::make_unique<OrderBook>(0, marketDataQueue, INITIAL_POOL_SIZE));
+        orderBookPool.push_back(std::make_unique<OrderBook>(0, marketDataQueue, INITIAL_POOL_SIZE, PRICE_BAND_TICKS));
     }
 }
 
@@ -56,17 +128,173 @@ std::unique_ptr<OrderBook> getOrderBook(TickerId id) {
         orderBook->reset();
         return orderBook;
     }
-    return std::make_unique<OrderBook>(id, marketDataQueue, INITIAL_POOL_SIZE);
+    return std::make_unique<OrderBook>(id, marketDataQueue, INITIAL_POOL_SIZE, PRICE_BAND_TICKS);
 }
 
-void processMessage(const ParsedMessage& msg) {
+/// Whether an order index entry's order is still in its book; entries of filled orders are not erased.
+bool isResting(const OrderRef& ref) {
+    return booksByTickerId[ref.tickerId]->holds(ref.handle);
+}
+
+/// Consecutive N/S/P/A/C/R messages for the same book, applied with a single OrderBook::applyBatch call so the
+/// book publishes its top of book once per burst instead of once per message.
+struct PendingBatch {
+    OrderBook* book = nullptr;
+    TickerId tickerId = 0;
+    std::vector<BookCommand> commands;
+    std::vector<const ParsedMessage*> messages;     // parallel to commands; nullptr for engine-generated expiries
+
+    /// True if a queued command already refers to this order; its index entry is not final until the flush.
+    bool touches(ClientId clientId, OrderId clientOrderId) const {
+        return std::any_of(commands.begin(), commands.end(), [&](const BookCommand& command) {
+            return command.clientId == clientId && command.clientOrderId == clientOrderId;
+        });
+    }
+};
+
+PendingBatch pendingBatch;
+
+/// Hand the parser thread's pre-trade checks a book's current reference price. One store, and only when
+/// the price moved.
+void publishReferencePrice(TickerId tickerId, const OrderBook& book) {
+    auto slot = referenceSlotsByTickerId[tickerId];
+    if (!slot) {
+        return;
+    }
+    const auto price = book.referencePrice();
+    if (slot->referencePrice.load(std::memory_order_relaxed) != price) {
+        slot->referencePrice.store(price, std::memory_order_relaxed);
+    }
+}
+
+void logMessageLatency(const ParsedMessage& msg, long long processing_duration) {
+    auto network_latency_us = duration_cast<nanoseconds>(msg.receiveTime.time_since_epoch()).count() - msg.sendTimeUs;
+    auto total_latency_us = processing_duration + network_latency_us;
+
+    logger.logLatency(msg.type, network_latency_us, processing_duration, total_latency_us);
+}
+
+void scheduleExpiry(Common::Nanos expireTime, const ExpiryTimer& timer) {
+    if (expiryWheel.empty()) {
+        // An idle wheel's clock has not been kept up to date; restart it at the present.
+        expiryWheel.clear(static_cast<uint64_t>(Common::getCurrentNanos() / EXPIRY_TICK));
+    }
+    expiryWheel.schedule(static_cast<uint64_t>((expireTime + EXPIRY_TICK - 1) / EXPIRY_TICK), timer);
+}
+
+void flushBatch() {
+    if (pendingBatch.commands.empty()) {
+        return;
+    }
     auto start_process_time = high_resolution_clock::now();
 
-    Symbol symbol;
-    std::strncpy(symbol.data(), msg.symbol.c_str(), symbol.size() - 1);
-    symbol[symbol.size() - 1] = '\0';
+    pendingBatch.book->applyBatch(pendingBatch.commands);
+    publishReferencePrice(pendingBatch.tickerId, *pendingBatch.book);
 
-    if (msg.type == "N") {
+    std::size_t messageCount = 0;
+    for (std::size_t i = 0; i < pendingBatch.commands.size(); ++i) {
+        const auto& command = pendingBatch.commands[i];
+        const auto msg = pendingBatch.messages[i];
+        messageCount += msg != nullptr;
+        if (command.type == BookCommand::Type::ADD || command.type == BookCommand::Type::STOP ||
+            command.type == BookCommand::Type::PEG) {
+            if (command.handle.valid()) {
+                orderIndex.insert(command.clientId, command.clientOrderId, OrderRef{pendingBatch.tickerId, command.handle},
+                                  isResting);
+                if (msg->expireTime > 0) {
+                    scheduleExpiry(msg->expireTime, ExpiryTimer{pendingBatch.tickerId, command.clientId,
+                                                                command.clientOrderId, command.handle});
+                }
+            }
+        } else if (command.type == BookCommand::Type::MODIFY) {
+            if (auto entry = orderIndex.find(command.clientId, command.clientOrderId)) {
+                entry->handle = command.handle;
+                if (!entry->valid()) {
+                    orderIndex.erase(command.clientId, command.clientOrderId, entry);
+                }
+            }
+        }
+    }
+
+    // The batch is timed as a whole; each message is charged its share.
+    auto end_process_time = high_resolution_clock::now();
+    if (messageCount > 0) {
+        auto processing_duration = duration_cast<nanoseconds>(end_process_time - start_process_time).count()
+                                 / static_cast<long long>(messageCount);
+        for (auto msg : pendingBatch.messages) {
+            if (msg) {
+                logMessageLatency(*msg, processing_duration);
+            }
+        }
+    }
+
+    pendingBatch.commands.clear();
+    pendingBatch.messages.clear();
+    pendingBatch.book = nullptr;
+}
+
+void enqueueCommand(OrderBook* book, TickerId tickerId, const BookCommand& command, const ParsedMessage* msg) {
+    if (book != pendingBatch.book) {
+        flushBatch();
+        pendingBatch.book = book;
+        pendingBatch.tickerId = tickerId;
+    }
+    pendingBatch.commands.push_back(command);
+    pendingBatch.messages.push_back(msg);
+}
+
+/// Cancel the good-till-date orders due by now. Runs between input batches on the engine thread; expiries
+/// for the same book go out as one batch, like a burst of cancels.
+void expireOrders() {
+    if (expiryWheel.empty()) {
+        return;
+    }
+    expiryWheel.advance(static_cast<uint64_t>(Common::getCurrentNanos() / EXPIRY_TICK), [](const ExpiryTimer& timer) {
+        // Anything else under this id means the order left the book and the id was reused.
+        auto entry = orderIndex.find(timer.clientId, timer.clientOrderId);
+        if (!entry || entry->tickerId != timer.tickerId || entry->handle.slot != timer.handle.slot ||
+            entry->handle.generation != timer.handle.generation) {
+            return;
+        }
+        orderIndex.erase(timer.clientId, timer.clientOrderId, entry);
+        enqueueCommand(booksByTickerId[timer.tickerId], timer.tickerId,
+                       BookCommand{.type = BookCommand::Type::EXPIRE, .clientId = timer.clientId,
+                                   .clientOrderId = timer.clientOrderId, .handle = timer.handle},
+                       nullptr);
+    });
+    flushBatch();
+}
+
+/// Free some of the tombstones lazy cancels left behind, from the first book that has any, or else the order
+/// index entries of filled orders for one client. Runs when the parser queue came up empty, so the work never
+/// delays a message.
+void compactBooks() {
+    for (auto book : booksByTickerId) {
+        if (book && book->hasTombstones()) {
+            book->compactTombstones(COMPACTION_BUDGET);
+            return;
+        }
+    }
+    orderIndex.sweep(isResting);
+}
+
+/// Route one message: order entry is queued on the pending batch, everything else is handled immediately.
+void routeMessage(const ParsedMessage& msg) {
+    auto start_process_time = high_resolution_clock::now();
+
+    const Symbol symbol = toSymbol(msg.symbol);
+    const auto clientId = static_cast<ClientId>(msg.userId);
+    const auto clientOrderId = static_cast<OrderId>(msg.userOrderId);
+
+    // The parser checked the order against the client's credit as it stood then; fills since may have used it up.
+    // Amends pass like cancels, so a blocked client can still work its resting orders down.
+    const bool entersOrder = msg.type == "N" || msg.type == "S" || msg.type == "P";
+    if (entersOrder && clientCredit.blocked(clientId)) [[unlikely]] {
+        publishReject(msg, msg.type == "P" ? 0 : msg.price, "Credit limit");
+        return;
+    }
+
+    if (msg.type == "N" || msg.type == "S" || msg.type == "P" || msg.type == "A") {
         auto it = symbolToTickerId.find(symbol);
         if (it == symbolToTickerId.end()) {
             it = symbolToTickerId.emplace(symbol, nextTickerId++).first;
@@ -75,34 +303,108 @@ void processMessage(const ParsedMessage& msg) {
         auto& orderBook = neworderBooks[symbol];
         if (!orderBook) {
             orderBook = getOrderBook(it->second);
+            orderBook->setDepthLevels(depthLevelsFor(symbol));
+            orderBook->setSelfTradePrevention(selfTradePreventionFor(symbol));
+            orderBook->setMatchingPolicy(matchingPolicyFor(symbol));
+            orderBook->setLazyCancels(lazyCancelsFor(symbol));
+            orderBook->setFillFeed(fillFeed);
+            if (booksByTickerId.size() <= it->second) {
+                booksByTickerId.resize(it->second + 1, nullptr);
+                referenceSlotsByTickerId.resize(it->second + 1, nullptr);
+            }
+            booksByTickerId[it->second] = orderBook.get();
+            referenceSlotsByTickerId[it->second] = referencePrices.findOrInsert(msg.symbol, defaultRiskLimits());
         }
 
-        orderBook->addOrder(msg.userId, msg.userOrderId, 
-                            msg.side == 'B' ? Side::BUY : Side::SELL, 
-                            msg.price, msg.quantity);
-        
-        orderIdToSymbol.emplace(msg.userOrderId, symbol);
-    }
-    else if (msg.type == "C") {
-        auto symbolIt = orderIdToSymbol.find(msg.userOrderId);
-        if (symbolIt != orderIdToSymbol.end()) {
-            auto& orderBook = neworderBooks[symbolIt->second];
-            if (orderBook->cancelOrder(msg.userId, msg.userOrderId)) {
-                orderIdToSymbol.erase(symbolIt);
-            }
+        const Side side = msg.side == 'B' ? Side::BUY : Side::SELL;
+        if (msg.type == "A") {
+            enqueueCommand(orderBook.get(), it->second,
+                           BookCommand{.type = msg.auctionAction == 'O' ? BookCommand::Type::OPEN_AUCTION
+                                                                        : BookCommand::Type::UNCROSS},
+                           &msg);
+        } else if (msg.type == "N") {
+            enqueueCommand(orderBook.get(), it->second,
+                           BookCommand{.type = BookCommand::Type::ADD, .clientId = clientId, .clientOrderId = clientOrderId,
+                                       .side = side, .price = msg.price, .quantity = msg.quantity,
+                                       // Good-till-date rests as a day order; the engine expires it.
+                                       .timeInForce = msg.timeInForce == 'I' ? TimeInForce::IOC
+                                                      : msg.timeInForce == 'F' ? TimeInForce::FOK : TimeInForce::DAY,
+                                       .displayQuantity = msg.displayQuantity},
+                           &msg);
+        } else if (msg.type == "S") {
+            enqueueCommand(orderBook.get(), it->second,
+                           BookCommand{.type = BookCommand::Type::STOP, .clientId = clientId, .clientOrderId = clientOrderId,
+                                       .side = side, .price = msg.price, .quantity = msg.quantity,
+                                       .triggerPrice = msg.triggerPrice},
+                           &msg);
         } else {
-            BOOST_LOG_SEV(g_logger, boost::log::trivial::info) << "C, " << msg.userId << ", " << msg.userOrderId << " (Not found in any book)";
+            enqueueCommand(orderBook.get(), it->second,
+                           BookCommand{.type = BookCommand::Type::PEG, .clientId = clientId, .clientOrderId = clientOrderId,
+                                       .side = side, .quantity = msg.quantity,
+                                       .pegType = msg.pegType == 'P' ? PegType::PRIMARY
+                                                  : msg.pegType == 'M' ? PegType::MARKET : PegType::MIDPOINT},
+                           &msg);
+        }
+        return;
+    }
+    else if (msg.type == "C" || msg.type == "R") {
+        if (pendingBatch.touches(clientId, clientOrderId)) {
+            flushBatch();
+        }
+        auto entry = orderIndex.find(clientId, clientOrderId);
+        if (entry) {
+            const auto ref = *entry;
+            if (msg.type == "C") {
+                // Orders filled since they rested leave a stale handle here; the book reports them as not found.
+                orderIndex.erase(clientId, clientOrderId, entry);
+                enqueueCommand(booksByTickerId[ref.tickerId], ref.tickerId,
+                               BookCommand{.type = BookCommand::Type::CANCEL, .clientId = clientId,
+                                           .clientOrderId = clientOrderId, .handle = ref.handle},
+                               &msg);
+            } else {
+                enqueueCommand(booksByTickerId[ref.tickerId], ref.tickerId,
+                               BookCommand{.type = BookCommand::Type::MODIFY, .clientId = clientId,
+                                           .clientOrderId = clientOrderId, .price = msg.price,
+                                           .quantity = msg.quantity, .handle = ref.handle},
+                               &msg);
+            }
+            return;
+        }
+        BOOST_LOG_SEV(g_logger, boost::log::trivial::info) << msg.type << ", " << msg.userId << ", " << msg.userOrderId << " (Not found in any book)";
+    } else if (msg.type == "K") {
+        // Applied directly to each book the client could have orders in; a book without any returns at once.
+        flushBatch();
+        const bool buys = msg.side != 'S';
+        const bool sells = msg.side != 'B';
+        if (msg.symbol.empty()) {
+            for (const auto& [name, tickerId] : symbolToTickerId) {
+                if (booksByTickerId[tickerId]->massCancel(clientId, buys, sells) > 0) {
+                    publishReferencePrice(tickerId, *booksByTickerId[tickerId]);
+                }
+            }
+        } else if (auto it = symbolToTickerId.find(symbol); it != symbolToTickerId.end()) {
+            if (booksByTickerId[it->second]->massCancel(clientId, buys, sells) > 0) {
+                publishReferencePrice(it->second, *booksByTickerId[it->second]);
+            }
         }
     } else if (msg.type == "F") { 
+        flushBatch();
+        // Books go back to the pool as they are; getOrderBook resets one only when a symbol reuses it.
         for (auto& [symbol, orderBook] : neworderBooks) {
-            orderBook->reset();
             orderBookPool.push_back(std::move(orderBook));
         }
         neworderBooks.clear();
+        booksByTickerId.clear();
+        referenceSlotsByTickerId.clear();
+        referencePrices.clearPrices();
         symbolToTickerId.clear();
-        orderIdToSymbol.clear();
+        orderIndex.clear();
+        expiryWheel.clear();
         nextTickerId = 1;
 
+        if (fillFeed) {
+            fillFeed->flush();
+        }
         marketDataQueue->enqueue(MarketData{
             MarketData::Type::FLUSH, 0, 0, 0, 0, 0, '-', 0, 0,
             "Book Flush Test #" + std::to_string(testCounter++)
@@ -110,24 +412,42 @@ void processMessage(const ParsedMessage& msg) {
     }
 
     auto end_process_time = high_resolution_clock::now();
-    auto processing_duration = duration_cast<nanoseconds>(end_process_time - start_process_time).count();
-    auto network_latency_us = duration_cast<nanoseconds>(msg.receiveTime.time_since_epoch()).count() - msg.sendTimeUs;
-    auto total_latency_us = processing_duration + network_latency_us;
+    logMessageLatency(msg, duration_cast<nanoseconds>(end_process_time - start_process_time).count());
+}
 
-    logger.logLatency(msg.type, network_latency_us, processing_duration, total_latency_us);
+/// Process a bulk-dequeued run of messages. Order-entry messages are queued per book and applied in batches;
+/// the last batch is flushed before returning, since the messages it points to are reused by the caller.
+void processMessages(const ParsedMessage* messages, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        routeMessage(messages[i]);
+    }
+    flushBatch();
+}
+
+void processMessage(const ParsedMessage& msg) {
+    processMessages(&msg, 1);
 }
 
 void matching_engine() {
     initializeOrderBookPool();
-    ParsedMessage msg;
+    std::vector<ParsedMessage> messages(MAX_BATCH_SIZE);
+    pendingBatch.commands.reserve(MAX_BATCH_SIZE);
+    pendingBatch.messages.reserve(MAX_BATCH_SIZE);
     while (true) {
-        if (parsedMessageQueue.try_dequeue(msg)) {
-            processMessage(msg);
+        if (auto count = parsedMessageQueue.try_dequeue_bulk(messages.begin(), MAX_BATCH_SIZE)) {
+            processMessages(messages.data(), count);
+        } else {
+            compactBooks();
+            if (fillFeed) {
+                fillFeed->retry();
+            }
         }
+        expireOrders();
     }
 }
 
-void initializeMatchingEngine(moodycamel::ConcurrentQueue<MarketData>* queue) {
+void initializeMatchingEngine(moodycamel::ConcurrentQueue<MarketData>* queue, FillFeed* fills) {
     marketDataQueue = queue;
+    fillFeed = fills;
     initializeOrderBookPool();
 }
\ No newline at end of file
@@ -10,4 +10,13 @@ extern Common::Logger logger;
 extern moodycamel::ConcurrentQueue<MarketData>* marketDataQueue;
 
 void matching_engine();
-void initializeMatchingEngine(moodycamel::ConcurrentQueue<MarketData>* queue);
\ No newline at end of file
+/// fills, when given, receives every trade and flush for the credit monitor; the engine is its only producer.
+void initializeMatchingEngine(moodycamel::ConcurrentQueue<MarketData>* queue, FillFeed* fills = nullptr);
+/// L2 depth published for a symbol's book (0, the default, disables it). Applies to books opened after the call.
+void setDepthLevels(const std::string& symbol, std::size_t levels);
+/// Self-trade prevention for a symbol's book (NONE by default). Applies to books opened after the call.
+void setSelfTradePrevention(const std::string& symbol, SelfTradePrevention mode);
+/// Matching policy for a symbol's book (FIFO by default). Applies to books opened after the call.
+void setMatchingPolicy(const std::string& symbol, MatchingPolicy policy);
+/// Lazy (tombstone) cancels for a symbol's book, off by default. Applies to books opened after the call.
+void setLazyCancels(const std::string& symbol, bool enabled);
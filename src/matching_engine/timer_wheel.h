@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+/// Hierarchical timing wheel: LEVELS wheels of SLOTS slots each, where a slot on level L spans SLOTS^L ticks.
+/// A timer is filed on the level of the highest digit (base SLOTS) where its expiry tick differs from the
+/// current tick, so scheduling is O(1). A timer only moves down a level when the wheel reaches its slot, at
+/// most LEVELS - 1 times, and fires from level 0. Expiries past the top wheel's current turn wait in an
+/// overflow list that is refiled when the next turn starts.
+/// Occupancy bitmaps let advance() jump straight to the next slot holding timers, so an idle wheel costs
+/// nothing however far the clock moves. Timers are pooled and linked by index; cancelled work is expected
+/// to be recognised by the callback rather than removed from the wheel.
+template<typename Payload>
+class TimerWheel {
+public:
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr unsigned LEVELS = 5;
+    static constexpr uint64_t SLOTS = uint64_t{1} << SLOT_BITS;
+    static constexpr uint64_t SPAN = uint64_t{1} << (SLOT_BITS * LEVELS);    // ticks the wheel can tell apart
+
+    TimerWheel() { clear(); }
+
+    /// Arrange for payload to be handed to advance()'s callback once the wheel reaches expiryTick.
+    /// Expiries at or before the current tick fire on the next tick.
+    void schedule(uint64_t expiryTick, const Payload& payload) {
+        uint32_t index;
+        if (freeHead != NIL) {
+            index = freeHead;
+            freeHead = timers[index].next;
+        } else {
+            index = static_cast<uint32_t>(timers.size());
+            timers.emplace_back();
+        }
+        timers[index].expiryTick = expiryTick;
+        timers[index].payload = payload;
+        file(index);
+        ++pending;
+    }
+
+    /// Move the wheel to nowTick, calling expired(payload) for every timer due by then, earliest slot first.
+    /// The callback may schedule new timers.
+    template<typename Callback>
+    void advance(uint64_t nowTick, Callback&& expired) {
+        while (currentTick < nowTick) {
+            const uint64_t tick = std::min(nextEventTick(), nowTick);
+            currentTick = tick;
+            // Bring down every level whose slot boundary this tick is on, top first, so a timer can fall
+            // through several levels in one go.
+            if ((tick & (SPAN - 1)) == 0) {
+                cascadeOverflow();
+            }
+            for (unsigned level = LEVELS - 1; level > 0; --level) {
+                if ((tick & ((uint64_t{1} << (SLOT_BITS * level)) - 1)) == 0) {
+                    cascade(level, slotOf(tick, level));
+                }
+            }
+            fire(slotOf(tick, 0), expired);
+        }
+    }
+
+    bool empty() const { return pending == 0; }
+    std::size_t size() const { return pending; }
+    uint64_t now() const { return currentTick; }
+
+    /// Drop every timer and restart the clock at startTick.
+    void clear(uint64_t startTick = 0) {
+        timers.clear();
+        freeHead = NIL;
+        overflowHead = NIL;
+        pending = 0;
+        currentTick = startTick;
+        for (auto& level : heads) {
+            std::fill(std::begin(level), std::end(level), NIL);
+        }
+        std::fill(std::begin(occupied), std::end(occupied), 0);
+    }
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Timer {
+        uint64_t expiryTick = 0;
+        uint32_t next = NIL;
+        Payload payload{};
+    };
+
+    std::vector<Timer> timers;
+    uint32_t freeHead;
+    uint32_t overflowHead;      // timers beyond the top wheel's current turn
+    std::size_t pending;
+    uint64_t currentTick;
+    uint32_t heads[LEVELS][SLOTS];
+    uint64_t occupied[LEVELS];
+
+    static uint64_t slotOf(uint64_t tick, unsigned level) {
+        return (tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+    }
+
+    /// Link a timer into the slot its expiry falls in, as seen from the current tick.
+    void file(uint32_t index) {
+        const uint64_t tick = std::max(timers[index].expiryTick, currentTick + 1);
+        const uint64_t differing = tick ^ currentTick;
+        if (differing >= SPAN) {
+            timers[index].next = overflowHead;
+            overflowHead = index;
+            return;
+        }
+        const auto level = static_cast<unsigned>(std::bit_width(differing) - 1) / SLOT_BITS;
+        link(index, level, slotOf(tick, level));
+    }
+
+    void link(uint32_t index, unsigned level, uint64_t slot) {
+        timers[index].next = heads[level][slot];
+        heads[level][slot] = index;
+        occupied[level] |= uint64_t{1} << slot;
+    }
+
+    /// First tick after the current one at which a timer fires or a slot holding timers must be cascaded.
+    /// Timers on a level always sit in slots ahead of the current tick's digit on that level.
+    uint64_t nextEventTick() const {
+        uint64_t next = overflowHead != NIL ? (currentTick | (SPAN - 1)) + 1 : UINT64_MAX;
+        for (unsigned level = 0; level < LEVELS; ++level) {
+            const auto shift = SLOT_BITS * level;
+            const auto digit = slotOf(currentTick, level);
+            const uint64_t ahead = digit + 1 < SLOTS ? occupied[level] >> (digit + 1) << (digit + 1) : 0;
+            if (ahead) {
+                const auto slot = static_cast<uint64_t>(std::countr_zero(ahead));
+                const uint64_t base = currentTick >> (shift + SLOT_BITS) << (shift + SLOT_BITS);
+                next = std::min(next, base | (slot << shift));
+            }
+        }
+        return next;
+    }
+
+    /// Empty a slot, refiling its timers from the current tick; they land on lower levels.
+    void cascade(unsigned level, uint64_t slot) {
+        auto index = heads[level][slot];
+        heads[level][slot] = NIL;
+        occupied[level] &= ~(uint64_t{1} << slot);
+        refile(index);
+    }
+
+    void cascadeOverflow() {
+        auto index = overflowHead;
+        overflowHead = NIL;
+        refile(index);
+    }
+
+    /// File a chain of timers again; those due at the current tick go into the level 0 slot about to fire.
+    void refile(uint32_t index) {
+        while (index != NIL) {
+            const auto next = timers[index].next;
+            if (timers[index].expiryTick <= currentTick) {
+                link(index, 0, slotOf(currentTick, 0));
+            } else {
+                file(index);
+            }
+            index = next;
+        }
+    }
+
+    template<typename Callback>
+    void fire(uint64_t slot, Callback& expired) {
+        auto index = heads[0][slot];
+        heads[0][slot] = NIL;
+        occupied[0] &= ~(uint64_t{1} << slot);
+        while (index != NIL) {
+            const auto next = timers[index].next;
+            const Payload payload = timers[index].payload;
+            timers[index].next = freeHead;
+            freeHead = index;
+            --pending;
+            expired(payload);
+            index = next;
+        }
+    }
+};
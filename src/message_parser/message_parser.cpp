@@ -1,5 +1,6 @@
 #include "message_parser.h"
 #include "logging_util.h"
+#include "pre_trade_risk.h"
 #include <array>
 #include <string_view>
 #include <charconv>
@@ -31,6 +32,11 @@ inline void parseMessage(const std::string& message, std::chrono::system_clock::
     if (part_count == 0 || parts[0].front() == '#') {
         return;
     }
+    // Stopping short of the end means a comma follows the last field kept: no message has that many fields.
+    if (end < msg_end) {
+        LOG(warning) << "Too many fields in message";
+        return;
+    }
 
     ParsedMessage parsedMsg;
     parsedMsg.receiveTime = receive_time;
@@ -40,18 +46,96 @@ inline void parseMessage(const std::string& message, std::chrono::system_clock::
 
     switch (parsedMsg.type.front()) {
         case 'N':
-            if (part_count == 8) {
+            if (part_count >= 8 && part_count <= 11) {
                 std::from_chars(parts[2].data(), parts[2].data() + parts[2].size(), parsedMsg.userId);
                 parsedMsg.symbol = parts[3];
                 std::from_chars(parts[4].data(), parts[4].data() + parts[4].size(), parsedMsg.price);
                 std::from_chars(parts[5].data(), parts[5].data() + parts[5].size(), parsedMsg.quantity);
                 parsedMsg.side = parts[6].front();
                 std::from_chars(parts[7].data(), parts[7].data() + parts[7].size(), parsedMsg.userOrderId);
+                if (part_count >= 9) {
+                    parsedMsg.timeInForce = parts[8].empty() ? 'D' : parts[8].front();
+                    if (parsedMsg.timeInForce != 'D' && parsedMsg.timeInForce != 'G' && parsedMsg.timeInForce != 'I' &&
+                        parsedMsg.timeInForce != 'F') {
+                        LOG(warning) << "Invalid time in force in 'N' message";
+                        return;
+                    }
+                }
+                if (part_count >= 10) {
+                    std::from_chars(parts[9].data(), parts[9].data() + parts[9].size(), parsedMsg.displayQuantity);
+                }
+                if (part_count == 11) {
+                    std::from_chars(parts[10].data(), parts[10].data() + parts[10].size(), parsedMsg.expireTime);
+                }
+                if ((parsedMsg.timeInForce == 'G') != (parsedMsg.expireTime > 0)) {
+                    LOG(warning) << "Good-till-date 'N' message needs an expire time, and only it takes one";
+                    return;
+                }
             } else {
                 LOG(warning) << "Invalid 'N' message format";
                 return;
             }
             break;
+        case 'S':
+            if (part_count == 9) {
+                std::from_chars(parts[2].data(), parts[2].data() + parts[2].size(), parsedMsg.userId);
+                parsedMsg.symbol = parts[3];
+                std::from_chars(parts[4].data(), parts[4].data() + parts[4].size(), parsedMsg.triggerPrice);
+                std::from_chars(parts[5].data(), parts[5].data() + parts[5].size(), parsedMsg.price);
+                std::from_chars(parts[6].data(), parts[6].data() + parts[6].size(), parsedMsg.quantity);
+                parsedMsg.side = parts[7].front();
+                std::from_chars(parts[8].data(), parts[8].data() + parts[8].size(), parsedMsg.userOrderId);
+            } else {
+                LOG(warning) << "Invalid 'S' message format";
+                return;
+            }
+            break;
+        case 'P':
+            if (part_count == 8) {
+                std::from_chars(parts[2].data(), parts[2].data() + parts[2].size(), parsedMsg.userId);
+                parsedMsg.symbol = parts[3];
+                parsedMsg.pegType = parts[4].empty() ? 0 : parts[4].front();
+                if (parsedMsg.pegType != 'P' && parsedMsg.pegType != 'M' && parsedMsg.pegType != 'D') {
+                    LOG(warning) << "Invalid peg type in 'P' message";
+                    return;
+                }
+                std::from_chars(parts[5].data(), parts[5].data() + parts[5].size(), parsedMsg.quantity);
+                parsedMsg.side = parts[6].front();
+                std::from_chars(parts[7].data(), parts[7].data() + parts[7].size(), parsedMsg.userOrderId);
+            } else {
+                LOG(warning) << "Invalid 'P' message format";
+                return;
+            }
+            break;
+        case 'A':
+            if (part_count == 4) {
+                parsedMsg.symbol = parts[2];
+                parsedMsg.auctionAction = parts[3].empty() ? 0 : parts[3].front();
+                if (parsedMsg.auctionAction != 'O' && parsedMsg.auctionAction != 'U') {
+                    LOG(warning) << "Invalid action in 'A' message";
+                    return;
+                }
+            } else {
+                LOG(warning) << "Invalid 'A' message format";
+                return;
+            }
+            break;
+        case 'K':
+            if (part_count >= 3 && part_count <= 5) {
+                std::from_chars(parts[2].data(), parts[2].data() + parts[2].size(), parsedMsg.userId);
+                if (part_count >= 4) {
+                    parsedMsg.symbol = parts[3];
+                }
+                parsedMsg.side = part_count == 5 && !parts[4].empty() ? parts[4].front() : 0;
+                if (parsedMsg.side != 0 && parsedMsg.side != 'B' && parsedMsg.side != 'S') {
+                    LOG(warning) << "Invalid side in 'K' message";
+                    return;
+                }
+            } else {
+                LOG(warning) << "Invalid 'K' message format";
+                return;
+            }
+            break;
         case 'C':
             if (part_count == 4) {
                 std::from_chars(parts[2].data(), parts[2].data() + parts[2].size(), parsedMsg.userId);
@@ -61,6 +145,17 @@ inline void parseMessage(const std::string& message, std::chrono::system_clock::
                 return;
             }
             break;
+        case 'R':
+            if (part_count == 6) {
+                std::from_chars(parts[2].data(), parts[2].data() + parts[2].size(), parsedMsg.userId);
+                std::from_chars(parts[3].data(), parts[3].data() + parts[3].size(), parsedMsg.userOrderId);
+                std::from_chars(parts[4].data(), parts[4].data() + parts[4].size(), parsedMsg.price);
+                std::from_chars(parts[5].data(), parts[5].data() + parts[5].size(), parsedMsg.quantity);
+            } else {
+                LOG(warning) << "Invalid 'R' message format";
+                return;
+            }
+            break;
         case 'F':
             break;
         default:
@@ -68,6 +163,11 @@ inline void parseMessage(const std::string& message, std::chrono::system_clock::
             return;
     }
 
+    // Orders outside their limits stop here; the engine never sees them.
+    if (!passesPreTradeRisk(parsedMsg)) {
+        return;
+    }
+
     parsedMessageQueue.enqueue(producer, std::move(parsedMsg));
 }
 
@@ -12,8 +12,14 @@ struct ParsedMessage {
     std::string symbol;
     int price;
     int quantity;
-    char side;
+    char side;                  // B or S; 0 in a K message that covers both sides
     int userOrderId;
+    int triggerPrice = 0;       // S only
+    char timeInForce = 'D';     // N only: D (day), G (good-till-date), I (immediate-or-cancel) or F (fill-or-kill)
+    int displayQuantity = 0;    // N only: iceberg slice size, 0 to display the whole order
+    long long expireTime = 0;   // N with G only: nanoseconds since the epoch, on the send timestamp's clock
+    char pegType = 0;           // P only: P (primary), M (market) or D (midpoint)
+    char auctionAction = 0;     // A only: O (open the call phase) or U (uncross)
 
     ParsedMessage() {
         // Preallocare spazio per il simbolo, assumendo una lunghezza massima di 16 caratteri
@@ -21,7 +27,7 @@ struct ParsedMessage {
     }
 };
 
-constexpr size_t MAX_PARTS = 10;
+constexpr size_t MAX_PARTS = 11;     // fields in the longest message, N; anything longer is rejected
 constexpr size_t INITIAL_QUEUE_SIZE = 100000;
 
 extern moodycamel::ConcurrentQueue<ParsedMessage> parsedMessageQueue;
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Multi-level 64-bit occupancy bitmap.
+/// Bit i of a word at layer d+1 is set when word i of layer d is non-zero, so finding the
+/// next set bit in either direction costs one tzcnt/lzcnt per layer regardless of how sparse the bitmap is.
+/// Each word carries the epoch it was last written in, and a word from an earlier epoch reads as zero, so
+/// clearAll() empties the whole bitmap by bumping the epoch. The epoch pads each word to 16 bytes, which for a
+/// ladder is 2 bits per tick beside the 64-bit slot pointer each tick already has.
+class LevelBitmap {
+public:
+    static constexpr std::size_t NPOS = static_cast<std::size_t>(-1);
+
+    explicit LevelBitmap(std::size_t capacity = 0) {
+        resize(capacity);
+    }
+
+    /// Resize to hold capacity bits; all bits are cleared.
+    void resize(std::size_t capacity) {
+        layers.clear();
+        epoch = 1;
+        std::size_t words = std::max<std::size_t>((capacity + 63) / 64, 1);
+        while (true) {
+            layers.emplace_back(words);
+            if (words == 1) break;
+            words = (words + 63) / 64;
+        }
+        bitCount = capacity;
+    }
+
+    std::size_t capacity() const { return bitCount; }
+
+    bool test(std::size_t i) const {
+        return (word(0, i >> 6) >> (i & 63)) & 1;
+    }
+
+    void set(std::size_t i) {
+        for (std::size_t d = 0; d < layers.size(); ++d) {
+            auto& word = liveWord(d, i >> 6);
+            const bool wasEmpty = word == 0;
+            word |= uint64_t{1} << (i & 63);
+            if (!wasEmpty) break;
+            i >>= 6;
+        }
+    }
+
+    void clear(std::size_t i) {
+        for (std::size_t d = 0; d < layers.size(); ++d) {
+            auto& word = liveWord(d, i >> 6);
+            word &= ~(uint64_t{1} << (i & 63));
+            if (word != 0) break;
+            i >>= 6;
+        }
+    }
+
+    /// Clear every bit in O(1). Once every 2^32 - 1 calls the epochs wrap and the words are cleared for real.
+    void clearAll() {
+        if (++epoch == 0) [[unlikely]] {
+            for (auto& layer : layers) {
+                std::fill(layer.begin(), layer.end(), Word{});
+            }
+            epoch = 1;
+        }
+    }
+
+    bool empty() const { return word(layers.size() - 1, 0) == 0; }
+
+    /// Lowest set bit, or NPOS.
+    std::size_t findFirst() const {
+        if (empty()) return NPOS;
+        return descendLowest(layers.size() - 1, std::countr_zero(word(layers.size() - 1, 0)));
+    }
+
+    /// Highest set bit, or NPOS.
+    std::size_t findLast() const {
+        if (empty()) return NPOS;
+        return descendHighest(layers.size() - 1, 63 - std::countl_zero(word(layers.size() - 1, 0)));
+    }
+
+    /// Lowest set bit strictly above i, or NPOS.
+    std::size_t findNextAbove(std::size_t i) const {
+        for (std::size_t d = 0; d < layers.size(); ++d) {
+            const auto bit = i & 63;
+            const uint64_t mask = bit == 63 ? 0 : ~uint64_t{0} << (bit + 1);
+            const auto bits = word(d, i >> 6) & mask;
+            if (bits) {
+                return descendLowest(d, (i & ~std::size_t{63}) | std::countr_zero(bits));
+            }
+            i >>= 6;
+        }
+        return NPOS;
+    }
+
+    /// Highest set bit strictly below i, or NPOS.
+    std::size_t findNextBelow(std::size_t i) const {
+        for (std::size_t d = 0; d < layers.size(); ++d) {
+            const auto bit = i & 63;
+            const uint64_t mask = (uint64_t{1} << bit) - 1;
+            const auto bits = word(d, i >> 6) & mask;
+            if (bits) {
+                return descendHighest(d, (i & ~std::size_t{63}) | (63 - std::countl_zero(bits)));
+            }
+            i >>= 6;
+        }
+        return NPOS;
+    }
+
+private:
+    struct Word {
+        uint64_t bits = 0;
+        uint32_t epoch = 0;     // epoch bits was last written in; older means the word is empty
+    };
+
+    std::vector<std::vector<Word>> layers;
+    std::size_t bitCount = 0;
+    uint32_t epoch = 1;
+
+    uint64_t word(std::size_t d, std::size_t i) const {
+        const auto& w = layers[d][i];
+        return w.epoch == epoch ? w.bits : 0;
+    }
+
+    /// Word i of layer d for writing, zeroed first if it dates from an earlier epoch.
+    uint64_t& liveWord(std::size_t d, std::size_t i) {
+        auto& w = layers[d][i];
+        if (w.epoch != epoch) {
+            w.bits = 0;
+            w.epoch = epoch;
+        }
+        return w.bits;
+    }
+
+    /// i is a set bit at layer d; follow the lowest set bits down to layer 0.
+    std::size_t descendLowest(std::size_t d, std::size_t i) const {
+        while (d-- > 0) {
+            i = (i << 6) | std::countr_zero(word(d, i));
+        }
+        return i;
+    }
+
+    std::size_t descendHighest(std::size_t d, std::size_t i) const {
+        while (d-- > 0) {
+            i = (i << 6) | (63 - std::countl_zero(word(d, i)));
+        }
+        return i;
+    }
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "OrdersAtPrice.h"
+#include "OptMemPool.h"
+
+/// Price levels for the ladders of one book. It starts with room for initialLevels and, when that runs out,
+/// adds a chunk as large as all the chunks before it, up to maxLevels in total. Chunks are never moved or
+/// freed before the pool is destroyed, so ladders and orders can keep raw pointers to levels.
+/// Each chunk is an OptMemPool with one spare block: the pool looks for its next free block right after
+/// every allocation, and the spare means it always finds one.
+class LevelPool {
+public:
+    LevelPool(std::size_t initialLevels, std::size_t maxLevels)
+        : maxLevels(std::max(maxLevels, initialLevels)), totalLevels(0), current(0) {
+        addChunk(std::max<std::size_t>(initialLevels, 1));
+    }
+
+    OrdersAtPrice* allocate(Price price) {
+        if (chunks[current].used == chunks[current].levels) [[unlikely]] {
+            current = chunkWithRoom();
+        }
+        auto& chunk = chunks[current];
+        ++chunk.used;
+        return chunk.pool->allocate(price);
+    }
+
+    void deallocate(const OrdersAtPrice* level) {
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            auto& chunk = chunks[i];
+            if (chunk.holds(level)) {
+                chunk.pool->deallocate(level);
+                --chunk.used;
+                current = std::min(current, i);
+                return;
+            }
+        }
+    }
+
+    /// Return every level at once; the chunks stay allocated for the next session.
+    void releaseAll() {
+        for (auto& chunk : chunks) {
+            chunk.pool->releaseAll();
+            chunk.used = 0;
+        }
+        current = 0;
+    }
+
+    std::size_t capacity() const { return totalLevels; }
+
+private:
+    struct Chunk {
+        std::unique_ptr<OptCommon::OptMemPool<OrdersAtPrice>> pool;
+        std::size_t levels;     // usable blocks, one fewer than the pool holds
+        std::size_t used;
+
+        bool holds(const OrdersAtPrice* level) const {
+            const std::less_equal<const OrdersAtPrice*> notAfter;
+            return notAfter(pool->at(0), level) && notAfter(level, pool->at(levels));
+        }
+    };
+
+    std::vector<Chunk> chunks;
+    std::size_t maxLevels;
+    std::size_t totalLevels;
+    std::size_t current;    // lowest chunk that may have room
+
+    std::size_t chunkWithRoom() {
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            if (chunks[i].used < chunks[i].levels) {
+                return i;
+            }
+        }
+        // Double the pool, but not past maxLevels; beyond it (a caller error) grow one level at a time.
+        addChunk(maxLevels > totalLevels ? std::min(totalLevels, maxLevels - totalLevels) : 1);
+        return chunks.size() - 1;
+    }
+
+    void addChunk(std::size_t levels) {
+        chunks.push_back({std::make_unique<OptCommon::OptMemPool<OrdersAtPrice>>(levels + 1), levels, 0});
+        totalLevels += levels;
+    }
+};
@@ -1,17 +1,52 @@
 #pragma once
 
 #include "Types.h"
+#include <cstdint>
 #include <iostream>
 
-struct Order {
-    ClientId clientId;
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/// Resting order as seen by the match loop: everything a fill reads or writes shares one aligned cache line.
+struct alignas(CACHE_LINE_SIZE) Order {
+    Order* prevOrder;
+    Order* nextOrder;
     OrderId clientOrderId;
     OrderId marketOrderId;
-    TickerId tickerId;
-    Side side;
     Price price;
     Qty quantity;
-    int priority;
-    Order* prevOrder;
-    Order* nextOrder;
-};
\ No newline at end of file
+    ClientId clientId;
+    Side side;
+    bool isIceberg;     // quantity is the displayed slice; the reserve is in OrderInfo
+};
+
+static_assert(sizeof(Order) == CACHE_LINE_SIZE, "Order hot fields must fit in one cache line");
+
+/// Per-order metadata matching never reads.
+/// Kept in an array parallel to the order pool and indexed by the order's pool slot.
+struct OrderInfo {
+    TickerId tickerId;
+    uint32_t generation;    // bumped whenever the slot's order leaves the book
+    uint32_t epoch;         // order pool epoch when the slot was last allocated; older means freed by a reset
+    Price triggerPrice;     // stop orders only
+    bool stopPending;       // waiting in the trigger book rather than resting in the price levels
+    Qty displayQuantity;    // icebergs only: size of each displayed slice
+    Qty hiddenQuantity;     // icebergs only: reserve not yet displayed
+    PegType pegType;        // NONE unless the order waits in a peg queue
+    uint32_t ownerList;     // the book's list of this client's orders, NO_OWNER_LIST until the order first rests
+    uint32_t ownerPrev;     // neighbours in that list, by pool slot
+    uint32_t ownerNext;
+
+    static constexpr uint32_t NO_OWNER_LIST = UINT32_MAX;
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+};
+
+/// Reference to a pooled order: its pool slot plus the slot generation when the handle was issued.
+/// The handle goes stale as soon as the order leaves the book, so holders never see a recycled slot.
+struct OrderHandle {
+    static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+    uint32_t slot = INVALID_SLOT;
+    uint32_t generation = 0;
+
+    bool valid() const { return slot != INVALID_SLOT; }
+};
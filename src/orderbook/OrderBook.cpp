@@ -1,106 +1,840 @@
 #include "OrderBook.h"
 #include "Order.h"
 #include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <utility>
 
-OrderBook::OrderBook(TickerId id, moodycamel::ConcurrentQueue<MarketData>* mdQueue, std::size_t initialPoolSize)
+namespace {
+    /// True if price a ranks ahead of price b among resting orders on the given side.
+    bool ranksAhead(Side side, Price a, Price b) {
+        return side == Side::BUY ? a > b : a < b;
+    }
+}
+
+OrderBook::OrderBook(TickerId id, moodycamel::ConcurrentQueue<MarketData>* mdQueue, std::size_t initialPoolSize,
+                     std::size_t priceBandTicks)
     : tickerId(id), 
       nextOrderId(1),
+      nextSequence(1),
       marketDataQueue(mdQueue), 
-      orderPool(initialPoolSize) {}
+      fillFeed(nullptr),
+      orderPool(initialPoolSize),
+      orderInfo(initialPoolSize),
+      // Two bands' worth of levels to start with; never more than the orders, as a level always holds one.
+      levelPool(std::min(initialPoolSize, 2 * priceBandTicks), initialPoolSize),
+      buyLevels(levelPool, priceBandTicks),
+      sellLevels(levelPool, priceBandTicks),
+      buyStops(levelPool, priceBandTicks),
+      sellStops(levelPool, priceBandTicks),
+      depthLevels(0),
+      selfTradePrevention(SelfTradePrevention::NONE),
+      matchingPolicy(MatchingPolicy::FIFO),
+      lazyCancels(false),
+      auctionOpen(false),
+      auctionChanged(false),
+      inUpdateScope(false),
+      dirtySides(0) {}
+
+OrderHandle OrderBook::addOrder(ClientId clientId, OrderId clientOrderId, Side side, Price price, Qty quantity,
+                                TimeInForce timeInForce, Qty displayQuantity) {
+    BookUpdateScope scope(*this);
+    Order* order = newOrder(clientId, clientOrderId, side, price, quantity);
+    if (displayQuantity > 0 && displayQuantity < quantity && price != 0) {
+        order->isIceberg = true;
+        infoOf(order).displayQuantity = displayQuantity;
+    }
+    publishAdd(order, "");
+
+    const auto handle = enterOrder(order, timeInForce);
+    releaseTriggeredStops();
+    return resolve(handle) ? handle : OrderHandle{};
+}
+
+OrderHandle OrderBook::addStopOrder(ClientId clientId, OrderId clientOrderId, Side side, Price triggerPrice,
+                                    Price limitPrice, Qty quantity) {
+    const bool valid = triggerPrice > 0 && limitPrice >= 0 && quantity > 0;
+    MarketData data = {
+        MarketData::Type::STOP,
+        tickerId,
+        clientId,
+        clientOrderId,
+        0, 0,
+        side == Side::BUY ? 'B' : 'S',
+        limitPrice,
+        quantity,
+        valid ? "" : "Rejected"
+    };
+    data.triggerPrice = triggerPrice;
+    if (!valid) {
+        publish(data);
+        return {};
+    }
 
-OrderBook::~OrderBook() {
-    for (const auto& pair : orderMap) {
-        orderPool.deallocate(pair.second);
+    Order* order = newOrder(clientId, clientOrderId, side, limitPrice, quantity);
+    auto& info = infoOf(order);
+    info.triggerPrice = triggerPrice;
+    info.stopPending = true;
+    if (side == Side::BUY) {
+        buyStops.findOrCreate(triggerPrice)->appendOrder(order);
+    } else {
+        sellStops.findOrCreate(triggerPrice)->appendOrder(order);
     }
+    trackOwner(order);
+
+    data.aggressiveMarketOrderId = order->marketOrderId;
+    data.aggressiveRemaining = quantity;
+    publish(data);
+    return handleOf(order);
 }
 
-void OrderBook::addOrder(ClientId clientId, OrderId clientOrderId, Side side, Price price, Qty quantity) {
-    auto marketOrderId = nextOrderId++;
-    
+OrderHandle OrderBook::addPegOrder(ClientId clientId, OrderId clientOrderId, Side side, PegType pegType, Qty quantity) {
+    BookUpdateScope scope(*this);
+    Order* order = newOrder(clientId, clientOrderId, side, 0, quantity);
+    infoOf(order).pegType = pegType;
+    publishAdd(order, "Pegged");
+
+    const auto handle = handleOf(order);
+    pegQueue(side, pegType).appendOrder(order);
+    ++restingPegs[static_cast<int>(side)];
+    trackOwner(order);
+    releaseTriggeredStops();
+    return resolve(handle) ? handle : OrderHandle{};
+}
+
+Order* OrderBook::newOrder(ClientId clientId, OrderId clientOrderId, Side side, Price price, Qty quantity) {
     Order* order = orderPool.allocate();
     order->clientId = clientId;
     order->clientOrderId = clientOrderId;
-    order->marketOrderId = marketOrderId;
-    order->tickerId = tickerId;
+    order->marketOrderId = nextOrderId++;
     order->side = side;
     order->price = price;
     order->quantity = quantity;
-    order->priority = 0;
     order->prevOrder = nullptr;
     order->nextOrder = nullptr;
+    order->isIceberg = false;
+    auto& info = infoOf(order);
+    if (info.epoch != orderPool.epoch()) {
+        // The slot's previous order was dropped by a reset without leaving the book, so its handles are live.
+        info.epoch = orderPool.epoch();
+        ++info.generation;
+    }
+    info.tickerId = tickerId;
+    info.stopPending = false;
+    info.hiddenQuantity = 0;
+    info.pegType = PegType::NONE;
+    info.ownerList = OrderInfo::NO_OWNER_LIST;
+    return order;
+}
 
-    clientOrderMap[clientOrderId] = std::make_pair(order, side);
-    orderMap[marketOrderId] = order;
-
+void OrderBook::publishAdd(const Order* order, const char* message) {
     MarketData data = {
         MarketData::Type::ADD,
         tickerId,
-        clientId,
-        clientOrderId,
+        order->clientId,
+        order->clientOrderId,
         0,  // passiveClientId not applicable for ADD
         0,  // passiveOrderId not applicable for ADD
-        side == Side::BUY ? 'B' : 'S',
-        price,
-        quantity,
-        ""  // message
+        order->side == Side::BUY ? 'B' : 'S',
+        order->price,
+        displayedQuantity(order),
+        message
     };
-    marketDataQueue->enqueue(data);
+    data.aggressiveMarketOrderId = order->marketOrderId;
+    data.aggressiveRemaining = data.quantity;
+    publish(data);
+}
 
-    if (price == 0) {
+/// Match a new order and rest, expire or release what is left of it.
+OrderHandle OrderBook::enterOrder(Order* order, TimeInForce timeInForce) {
+    // An auction only collects orders that can wait for the uncross.
+    if (auctionOpen && (order->price == 0 || timeInForce != TimeInForce::DAY)) {
+        expireOrder(order, "Rejected");
+        return {};
+    }
+
+    // A FOK that cannot fill is killed on the level totals alone, before any resting order is touched.
+    if (timeInForce == TimeInForce::FOK && !canFillCompletely(order)) {
+        expireOrder(order, "Killed");
+        return {};
+    }
+
+    if (order->price == 0) {
         processMarketOrder(order);
+        releaseOrder(order);
+        return {};
     } else {
-        if (side == Side::BUY) {
-            matchOrder<SellOrderMap>(order, sellOrders.begin(), sellOrders.end());
+        matchAgainstBook(order);
+
+        if (order->quantity > 0 && timeInForce != TimeInForce::DAY) {
+            expireOrder(order, "Expired");
+            return {};
+        }
+        if (order->quantity > 0) {
+            restOrder(order);
+            markTopOfBook(order);
+            return handleOf(order);
+        }
+        releaseOrder(order);
+        return {};
+    }
+}
+
+/// Fire every stop whose trigger the trades since the last check reached, including stops set off by the
+/// orders fired here. Each trigger book is read from its best trigger, so untouched stops are never visited.
+/// Pegs left overlapping by the new touch trade here too, since their prints can fire stops in turn.
+void OrderBook::releaseTriggeredStops() {
+    while (true) {
+        if (uncrossPegs()) {
+            continue;
+        }
+        Order* stop = nullptr;
+        if (auto level = buyStops.best(); level && tradeHigh >= level->price) {
+            stop = level->firstOrder;
+            removeStop(stop, buyStops);
+        } else if (auto level = sellStops.best(); level && tradeLow <= level->price) {
+            stop = level->firstOrder;
+            removeStop(stop, sellStops);
         } else {
-            matchOrder<BuyOrderMap>(order, buyOrders.begin(), buyOrders.end());
+            break;
         }
+        publishAdd(stop, "Triggered");
+        enterOrder(stop, TimeInForce::DAY);
+    }
+    tradeHigh = std::numeric_limits<Price>::min();
+    tradeLow = std::numeric_limits<Price>::max();
+}
 
-        if (order->quantity > 0) {
+/// A peg's price for the current touch, 0 while the prices it tracks are missing.
+/// Buy pegs round down and sell pegs round up, so no peg ever crosses the displayed book.
+Price OrderBook::pegPrice(Side side, PegType type) const {
+    const auto bid = buyLevels.best();
+    const auto ask = sellLevels.best();
+    switch (type) {
+        case PegType::PRIMARY:
             if (side == Side::BUY) {
-                auto it = buyOrders.find(price);
-                if (it == buyOrders.end()) {
-                    auto ordersAtPrice = std::make_unique<OrdersAtPrice>(price);
-                    ordersAtPrice->appendOrder(order);
-                    buyOrders.emplace(price, std::move(ordersAtPrice));
-                } else {
-                    it->second->appendOrder(order);
-                }
-            } else {
-                auto it = sellOrders.find(price);
-                if (it == sellOrders.end()) {
-                    auto ordersAtPrice = std::make_unique<OrdersAtPrice>(price);
-                    ordersAtPrice->appendOrder(order);
-                    sellOrders.emplace(price, std::move(ordersAtPrice));
-                } else {
-                    it->second->appendOrder(order);
-                }
+                return bid ? bid->price : 0;
             }
-            publishTopOfBook(order, false);
+            return ask ? ask->price : 0;
+        case PegType::MARKET:
+            if (side == Side::BUY) {
+                return ask ? ask->price - 1 : 0;
+            }
+            return bid ? bid->price + 1 : 0;
+        case PegType::MIDPOINT:
+            if (!bid || !ask) {
+                return 0;
+            }
+            return side == Side::BUY ? (bid->price + ask->price) / 2 : (bid->price + ask->price + 1) / 2;
+        case PegType::NONE:
+            break;
+    }
+    return 0;
+}
+
+OrderBook::PegQuotes OrderBook::pegQuotes(Side side) const {
+    PegQuotes quotes{};
+    if (restingPegs[static_cast<int>(side)] == 0) {
+        return quotes;
+    }
+    for (std::size_t i = 0; i < PEG_TYPES; ++i) {
+        if (pegQueues[static_cast<int>(side)][i].firstOrder) {
+            quotes.price[i] = pegPrice(side, static_cast<PegType>(i + 1));
+            quotes.any |= quotes.price[i] != 0;
+        }
+    }
+    return quotes;
+}
+
+/// The peg queue whose head trades next on a side: best price, then the oldest head.
+OrdersAtPrice* OrderBook::bestPeg(Side side, const PegQuotes& quotes, Price& price) {
+    OrdersAtPrice* best = nullptr;
+    for (std::size_t i = 0; i < PEG_TYPES; ++i) {
+        auto& queue = pegQueues[static_cast<int>(side)][i];
+        const Price quote = quotes.price[i];
+        if (quote == 0 || !queue.firstOrder) {
+            continue;
+        }
+        if (!best || ranksAhead(side, quote, price) ||
+            (quote == price && queue.firstOrder->marketOrderId < best->firstOrder->marketOrderId)) {
+            best = &queue;
+            price = quote;
+        }
+    }
+    return best;
+}
+
+/// Fill an incoming order against the pegs of one side, best first. Before a level is swept only pegs inside
+/// it are taken (all of them when the side has no levels); once its displayed orders are gone, pegs at its
+/// price follow. Each trade prints at the peg's price.
+void OrderBook::matchPegs(Order* order, Side side, const PegQuotes& quotes, const OrdersAtPrice* level, bool atLevel) {
+    while (order->quantity > 0) {
+        Price price = 0;
+        auto queue = bestPeg(side, quotes, price);
+        if (!queue || (order->price != 0 && ranksAhead(side, order->price, price))) {
+            return;
+        }
+        if (level && (atLevel ? ranksAhead(side, level->price, price) : !ranksAhead(side, price, level->price))) {
+            return;
+        }
+
+        auto peg = queue->firstOrder;
+        if (peg->clientId == order->clientId && selfTradePrevention != SelfTradePrevention::NONE) [[unlikely]] {
+            if (preventSelfTrade(order, peg, queue)) {
+                removePeg(peg);
+                releaseOrder(peg);
+            }
+            continue;
+        }
+        const auto matchQty = std::min(order->quantity, peg->quantity);
+        queue->totalQuantity -= matchQty;
+        executeMatch(order, peg, matchQty, price);
+        if (peg->quantity == 0) {
+            removePeg(peg);
+            releaseOrder(peg);
+        }
+    }
+}
+
+/// Trade the best buy peg against the best sell peg if the touch has left them overlapping. The newer of the
+/// two is the aggressor and the print is at the older one's price. Returns true if a trade happened.
+bool OrderBook::uncrossPegs() {
+    if (restingPegs[0] == 0 || restingPegs[1] == 0 || auctionOpen) {
+        return false;
+    }
+    Price bidPrice = 0;
+    Price askPrice = 0;
+    auto bidQueue = bestPeg(Side::BUY, pegQuotes(Side::BUY), bidPrice);
+    auto askQueue = bestPeg(Side::SELL, pegQuotes(Side::SELL), askPrice);
+    if (!bidQueue || !askQueue || bidPrice < askPrice) {
+        return false;
+    }
+
+    auto buy = bidQueue->firstOrder;
+    auto sell = askQueue->firstOrder;
+    const bool buyIsNewer = buy->marketOrderId > sell->marketOrderId;
+    if (buy->clientId == sell->clientId && selfTradePrevention != SelfTradePrevention::NONE) {
+        // The newer peg plays the aggressor; its queue total is settled here since it is resting too.
+        auto newer = buyIsNewer ? buy : sell;
+        auto newerQueue = buyIsNewer ? bidQueue : askQueue;
+        const Qty before = newer->quantity;
+        preventSelfTrade(newer, buyIsNewer ? sell : buy, buyIsNewer ? askQueue : bidQueue);
+        newerQueue->totalQuantity -= before - newer->quantity;
+    } else {
+        const auto matchQty = std::min(buy->quantity, sell->quantity);
+        bidQueue->totalQuantity -= matchQty;
+        askQueue->totalQuantity -= matchQty;
+        if (buyIsNewer) {
+            executeMatch(buy, sell, matchQty, askPrice);
+        } else {
+            executeMatch(sell, buy, matchQty, bidPrice);
+        }
+    }
+    for (auto peg : {buy, sell}) {
+        if (peg->quantity == 0) {
+            removePeg(peg);
+            releaseOrder(peg);
+        }
+    }
+    return true;
+}
+
+void OrderBook::removePeg(Order* order) {
+    pegQueue(order->side, infoOf(order).pegType).removeOrderFromLevel(order);
+    --restingPegs[static_cast<int>(order->side)];
+    order->prevOrder = nullptr;
+    order->nextOrder = nullptr;
+}
+
+template<typename Ladder>
+void OrderBook::removeStop(Order* order, Ladder& stops) {
+    auto level = stops.find(infoOf(order).triggerPrice);
+    level->removeOrderFromLevel(order);
+    if (level->orderCount == 0) {
+        stops.erase(level);
+    }
+    order->prevOrder = nullptr;
+    order->nextOrder = nullptr;
+    infoOf(order).stopPending = false;
+}
+
+OrderHandle OrderBook::modifyOrder(ClientId clientId, OrderId clientOrderId, OrderHandle handle, Price price, Qty quantity) {
+    BookUpdateScope scope(*this);
+    Order* order = resolve(handle);
+    if (!order || order->clientId != clientId || order->clientOrderId != clientOrderId || price <= 0 || quantity <= 0 ||
+        infoOf(order).stopPending || infoOf(order).pegType != PegType::NONE) {
+        MarketData data = {
+            MarketData::Type::MODIFY,
+            tickerId,
+            clientId,
+            clientOrderId,
+            0, 0,
+            order ? (order->side == Side::BUY ? 'B' : 'S') : '-',
+            price,
+            quantity,
+            order ? "Rejected" : "Not found"
+        };
+        if (order) {
+            data.aggressiveMarketOrderId = order->marketOrderId;
+            data.aggressiveRemaining = order->quantity;
+        }
+        publish(data);
+        return order ? handle : OrderHandle{};
+    }
+
+    const Side side = order->side;
+    const bool wasAtTouch = isBestPrice(order);
+
+    // The quantity is the whole open quantity, an iceberg's reserve included.
+    auto& info = infoOf(order);
+    const Qty reserve = order->isIceberg ? info.hiddenQuantity : 0;
+    const bool inPlace = price == order->price && quantity <= order->quantity + reserve;
+    // An in-place size down comes out of the reserve first.
+    const Qty fromReserve = inPlace ? std::min(order->quantity + reserve - quantity, reserve) : 0;
+    const Qty fromDisplayed = inPlace ? order->quantity + reserve - quantity - fromReserve : 0;
+
+    MarketData data = {
+        MarketData::Type::MODIFY,
+        tickerId,
+        clientId,
+        clientOrderId,
+        0, 0,
+        side == Side::BUY ? 'B' : 'S',
+        price,
+        inPlace ? order->quantity - fromDisplayed
+                : order->isIceberg ? std::min(quantity, info.displayQuantity) : quantity,
+        ""
+    };
+    data.aggressiveMarketOrderId = order->marketOrderId;
+    data.aggressiveRemaining = data.quantity;
+    publish(data);
+
+    if (inPlace) {
+        // Size down at the same price keeps queue priority.
+        auto level = side == Side::BUY ? buyLevels.find(price) : sellLevels.find(price);
+        info.hiddenQuantity -= fromReserve;
+        level->hiddenQuantity -= fromReserve;
+        level->totalQuantity -= fromDisplayed;
+        order->quantity -= fromDisplayed;
+        noteAuctionChange(side, price);
+        if (const auto rank = depthRank(level); rank < depthLevels) {
+            publishDepth(side, MarketData::DepthAction::CHANGE, rank, level->price, level->totalQuantity);
+        }
+        if (wasAtTouch) {
+            markTopOfBook(order);
+        }
+        return handle;
+    }
+
+    // Any other change is a cancel and re-insert of the same pooled order: it loses priority and may cross.
+    removeOrderFromBook(order, side);
+    order->prevOrder = nullptr;
+    order->nextOrder = nullptr;
+    order->price = price;
+    order->quantity = quantity;
+
+    matchAgainstBook(order);
+
+    if (order->quantity == 0) {
+        if (wasAtTouch) {
+            markSideDirty(side);
+        }
+        releaseOrder(order);
+    } else {
+        restOrder(order);
+        if (wasAtTouch || isBestPrice(order)) {
+            markSideDirty(side);
         }
     }
+    releaseTriggeredStops();
+    return resolve(handle) ? handle : OrderHandle{};
+}
+
+void OrderBook::applyBatch(std::span<BookCommand> commands) {
+    BookUpdateScope scope(*this);
+    for (auto& command : commands) {
+        switch (command.type) {
+            case BookCommand::Type::ADD:
+                command.handle = addOrder(command.clientId, command.clientOrderId, command.side,
+                                          command.price, command.quantity, command.timeInForce,
+                                          command.displayQuantity);
+                break;
+            case BookCommand::Type::CANCEL:
+                cancelOrder(command.clientId, command.clientOrderId, command.handle);
+                command.handle = {};
+                break;
+            case BookCommand::Type::STOP:
+                command.handle = addStopOrder(command.clientId, command.clientOrderId, command.side,
+                                              command.triggerPrice, command.price, command.quantity);
+                break;
+            case BookCommand::Type::PEG:
+                command.handle = addPegOrder(command.clientId, command.clientOrderId, command.side,
+                                             command.pegType, command.quantity);
+                break;
+            case BookCommand::Type::OPEN_AUCTION:
+                openAuction();
+                break;
+            case BookCommand::Type::UNCROSS:
+                uncrossAuction();
+                break;
+            case BookCommand::Type::EXPIRE:
+                if (!expireGoodTillDate(command.handle)) {
+                    command.handle = {};
+                }
+                break;
+            case BookCommand::Type::MODIFY:
+                command.handle = modifyOrder(command.clientId, command.clientOrderId, command.handle,
+                                             command.price, command.quantity);
+                break;
+        }
+    }
+}
+
+void OrderBook::restOrder(Order* order) {
+    auto level = order->side == Side::BUY ? buyLevels.findOrCreate(order->price) : sellLevels.findOrCreate(order->price);
+    if (order->isIceberg) {
+        // Until it rests an iceberg carries its whole open quantity; split off the reserve now.
+        auto& info = infoOf(order);
+        const Qty displayed = std::min(order->quantity, info.displayQuantity);
+        info.hiddenQuantity = order->quantity - displayed;
+        order->quantity = displayed;
+        level->hiddenQuantity += info.hiddenQuantity;
+    }
+    level->appendOrder(order);
+    noteAuctionChange(order->side, order->price);
+    trackOwner(order);
+    if (matchingPolicy == MatchingPolicy::TOP_ORDER_PRO_RATA && level->orderCount == 1 &&
+        level == (order->side == Side::BUY ? buyLevels.best() : sellLevels.best())) {
+        level->topOrder = order;
+    }
+    if (const auto rank = depthRank(level); rank < depthLevels) {
+        publishDepth(order->side, level->orderCount == 1 ? MarketData::DepthAction::NEW : MarketData::DepthAction::CHANGE,
+                     rank, level->price, level->totalQuantity);
+    }
+}
+
+/// Show the next slice of an iceberg whose displayed quantity has just traded away. The slice loses
+/// priority: it joins the back of the level's queue. Returns false once the reserve is used up.
+bool OrderBook::replenish(Order* order, OrdersAtPrice* level) {
+    auto& info = infoOf(order);
+    if (info.hiddenQuantity == 0) {
+        return false;
+    }
+    const Qty slice = std::min(info.hiddenQuantity, info.displayQuantity);
+    info.hiddenQuantity -= slice;
+    level->hiddenQuantity -= slice;
+    order->quantity = slice;
+    level->totalQuantity += slice;
+    if (level->topOrder == order) {
+        level->topOrder = nullptr;
+    }
+
+    if (level->lastOrder != order) {
+        order->prevOrder = level->lastOrder;
+        order->nextOrder = nullptr;
+        level->lastOrder->nextOrder = order;
+        level->lastOrder = order;
+    }
+    publishAdd(order, "Replenished");
+    return true;
+}
+
+OrderHandle OrderBook::handleOf(const Order* order) const {
+    const auto slot = orderPool.indexOf(order);
+    return {static_cast<uint32_t>(slot), orderInfo[slot].generation};
+}
+
+bool OrderBook::holds(OrderHandle handle) const {
+    return handle.slot < orderInfo.size() && orderInfo[handle.slot].generation == handle.generation &&
+           orderInfo[handle.slot].epoch == orderPool.epoch();
+}
+
+Order* OrderBook::resolve(OrderHandle handle) {
+    return holds(handle) ? orderPool.at(handle.slot) : nullptr;
 }
 
 void OrderBook::processMarketOrder(Order* order) {
+    matchAgainstBook(order);
+}
+
+/// Match against the opposite side. The book's policy is resolved here, once per order, not per fill.
+void OrderBook::matchAgainstBook(Order* order) {
+    if (auctionOpen) {
+        return;
+    }
     if (order->side == Side::BUY) {
-        matchOrder<SellOrderMap>(order, sellOrders.begin(), sellOrders.end());
+        matchWithPolicy(order, sellLevels);
     } else {
-        matchOrder<BuyOrderMap>(order, buyOrders.begin(), buyOrders.end());
+        matchWithPolicy(order, buyLevels);
+    }
+}
+
+template<typename Ladder>
+void OrderBook::matchWithPolicy(Order* order, Ladder& levels) {
+    switch (matchingPolicy) {
+        case MatchingPolicy::FIFO:
+            matchOrder<MatchingPolicy::FIFO>(order, levels);
+            break;
+        case MatchingPolicy::PRO_RATA:
+            matchOrder<MatchingPolicy::PRO_RATA>(order, levels);
+            break;
+        case MatchingPolicy::TOP_ORDER_PRO_RATA:
+            matchOrder<MatchingPolicy::TOP_ORDER_PRO_RATA>(order, levels);
+            break;
     }
 }
 
+/// Share an incoming order out over one price level in proportion to the resting sizes.
+/// Same-client orders are settled by self-trade prevention before anything is allocated, and a top order
+/// is filled ahead of the split. Each round allocates the whole incoming quantity (or fills the level
+/// outright when it is smaller); rounds repeat only while iceberg slices are replenished into an exhausted level.
+void OrderBook::fillProRata(Order* order, OrdersAtPrice* level, Side passiveSide, bool topOrderFirst) {
+    if (selfTradePrevention != SelfTradePrevention::NONE) {
+        for (auto resting = level->firstOrder; resting && order->quantity > 0;) {
+            auto nextOrder = resting->nextOrder;
+            if (resting->clientId == order->clientId) {
+                markSideDirty(passiveSide);
+                if (preventSelfTrade(order, resting, level)) {
+                    level->removeOrderFromLevel(resting);
+                    releaseOrder(resting);
+                }
+            }
+            resting = nextOrder;
+        }
+    }
+
+    if (topOrderFirst && level->topOrder && order->quantity > 0) {
+        auto topOrder = level->topOrder;
+        const auto matchQty = std::min(order->quantity, topOrder->quantity);
+        level->totalQuantity -= matchQty;
+        executeMatch(order, topOrder, matchQty, level->price);
+        markSideDirty(passiveSide);
+        if (topOrder->quantity == 0) {
+            settleFill(topOrder, level);
+        }
+    }
+
+    while (order->quantity > 0 && level->firstOrder) {
+        allocationOrders.clear();
+        allocationSizes.clear();
+        for (auto resting = level->firstOrder; resting; resting = resting->nextOrder) {
+            allocationOrders.push_back(resting);
+            allocationSizes.push_back(resting->quantity);
+        }
+        const auto count = allocationOrders.size();
+        allocations.resize(count);
+
+        const Qty incoming = order->quantity;
+        const Qty total = level->totalQuantity;
+        if (incoming >= total) {
+            std::copy(allocationSizes.begin(), allocationSizes.end(), allocations.begin());
+        } else {
+            // One branch-free pass over the sizes, so it vectorizes: each share is size * incoming / total in
+            // 32.32 fixed point, which rounds at most one below the exact quotient, then stepped up where it did.
+            const uint64_t ratio = (static_cast<uint64_t>(incoming) << 32) / static_cast<uint64_t>(total);
+            const Qty* sizes = allocationSizes.data();
+            Qty* shares = allocations.data();
+            Qty allocated = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                const uint64_t size = static_cast<uint32_t>(sizes[i]);
+                const uint64_t share = (size * ratio) >> 32;
+                const bool roundedDown = (share + 1) * static_cast<uint64_t>(total) <= size * static_cast<uint64_t>(incoming);
+                shares[i] = static_cast<Qty>(share + roundedDown);
+                allocated += shares[i];
+            }
+            // The rounding remainder goes to the front of the queue.
+            for (std::size_t i = 0; i < count && allocated < incoming; ++i) {
+                const Qty extra = std::min(incoming - allocated, sizes[i] - shares[i]);
+                shares[i] += extra;
+                allocated += extra;
+            }
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            if (allocations[i] == 0) {
+                continue;
+            }
+            auto resting = allocationOrders[i];
+            level->totalQuantity -= allocations[i];
+            executeMatch(order, resting, allocations[i], level->price);
+            if (resting->quantity == 0) {
+                settleFill(resting, level);
+            }
+        }
+        markSideDirty(passiveSide);
+    }
+}
+
+/// Take a filled order out of its level, or show an iceberg's next slice at the back of the queue.
+/// Unlike the FIFO sweep, which trims its filled prefix in one go, pro-rata and auction fills settle each
+/// order on its own, wherever it stands in the queue.
+void OrderBook::settleFill(Order* restingOrder, OrdersAtPrice* level) {
+    if (restingOrder->isIceberg && infoOf(restingOrder).hiddenQuantity > 0) {
+        if (level->lastOrder != restingOrder) {
+            (restingOrder->prevOrder ? restingOrder->prevOrder->nextOrder : level->firstOrder) = restingOrder->nextOrder;
+            restingOrder->nextOrder->prevOrder = restingOrder->prevOrder;
+        }
+        replenish(restingOrder, level);
+        return;
+    }
+    level->removeOrderFromLevel(restingOrder);
+    releaseOrder(restingOrder);
+}
+
+/// Quantity resting on passiveSide, displayed, hidden and pegged, at prices an order limited at limitPrice
+/// (0 for no limit) could trade, counted only until it reaches wanted.
+Qty OrderBook::liquidityThrough(Side passiveSide, Price limitPrice, Qty wanted, const PegQuotes& pegs) const {
+    Qty available = passiveSide == Side::SELL ? sellLevels.liquidityThrough(limitPrice, wanted)
+                                              : buyLevels.liquidityThrough(limitPrice, wanted);
+    for (std::size_t i = 0; pegs.any && i < PEG_TYPES && available < wanted; ++i) {
+        if (pegs.price[i] != 0 && (limitPrice == 0 || !ranksAhead(passiveSide, limitPrice, pegs.price[i]))) {
+            available += pegQueues[static_cast<int>(passiveSide)][i].totalQuantity;
+        }
+    }
+    return available;
+}
+
+/// With self-trade prevention on, the client's own resting orders are not liquidity for its FOK. Under
+/// CANCEL_OLDEST they are cancelled as the order reaches them and it trades on, so they are only left out of
+/// the count. Under the other modes reaching one cuts the FOK short, so it must fill entirely at prices
+/// ranked ahead of the best of them.
+bool OrderBook::canFillCompletely(const Order* order) const {
+    const Side passiveSide = order->side == Side::BUY ? Side::SELL : Side::BUY;
+    const auto pegs = pegQuotes(passiveSide);
+    const auto list = selfTradePrevention == SelfTradePrevention::NONE ? ownerLists.end()
+                                                                        : ownerLists.find(order->clientId);
+    if (list == ownerLists.end()) {
+        return liquidityThrough(passiveSide, order->price, order->quantity, pegs) >= order->quantity;
+    }
+
+    Qty ownQuantity = 0;
+    Price ownBest = 0;
+    for (auto slot = ownerHead(list->second); slot != OrderInfo::NO_SLOT; slot = orderInfo[slot].ownerNext) {
+        const Order* resting = orderPool.at(slot);
+        const auto& info = orderInfo[slot];
+        if (resting->side != passiveSide || info.stopPending) {
+            continue;
+        }
+        const Price price = info.pegType == PegType::NONE ? resting->price
+                                                          : pegs.price[static_cast<int>(info.pegType) - 1];
+        if (price == 0 || (order->price != 0 && ranksAhead(passiveSide, order->price, price))) {
+            continue;
+        }
+        if (ownQuantity == 0 || ranksAhead(passiveSide, price, ownBest)) {
+            ownBest = price;
+        }
+        ownQuantity += resting->quantity + info.hiddenQuantity;
+    }
+    if (ownQuantity == 0) {
+        return liquidityThrough(passiveSide, order->price, order->quantity, pegs) >= order->quantity;
+    }
+    if (selfTradePrevention == SelfTradePrevention::CANCEL_OLDEST) {
+        return liquidityThrough(passiveSide, order->price, order->quantity + ownQuantity, pegs) - ownQuantity >=
+               order->quantity;
+    }
+    // One tick inside the best own price; nothing ranks ahead of a sell at the lowest possible price.
+    const Price inside = passiveSide == Side::SELL ? ownBest - 1 : ownBest + 1;
+    return inside > 0 && liquidityThrough(passiveSide, inside, order->quantity, pegs) >= order->quantity;
+}
+
+/// Drop an order that was never rested, reporting what was left of it as cancelled.
+void OrderBook::expireOrder(Order* order, const char* reason) {
+    MarketData data = {
+        MarketData::Type::CANCEL,
+        tickerId,
+        order->clientId,
+        order->clientOrderId,
+        0, 0,
+        order->side == Side::BUY ? 'B' : 'S',
+        order->price,
+        order->quantity,
+        reason
+    };
+    data.aggressiveMarketOrderId = order->marketOrderId;
+    publish(data);
+    releaseOrder(order);
+}
+
 bool OrderBook::isBestPrice(const Order* order) const {
     if (order->side == Side::BUY) {
-        return buyOrders.empty() || order->price >= buyOrders.rbegin()->first;
+        return buyLevels.empty() || order->price >= buyLevels.best()->price;
     } else {
-        return sellOrders.empty() || order->price <= sellOrders.begin()->first;
+        return sellLevels.empty() || order->price <= sellLevels.best()->price;
     }
 }
 
+/// Called instead of a fill when both sides of it belong to the same client. Cancelled or decremented orders
+/// are reported as CANCEL or MODIFY records marked "Self-trade". The resting order's quantities and its level
+/// totals are settled here; if it leaves the book (true is returned) the caller unlinks and releases it.
+/// A cancelled aggressor is left with no quantity.
+bool OrderBook::preventSelfTrade(Order* aggressiveOrder, Order* restingOrder, OrdersAtPrice* level) {
+    auto& restingInfo = infoOf(restingOrder);
+    const Qty restingHidden = restingOrder->isIceberg ? restingInfo.hiddenQuantity : 0;
+    bool cancelAggressive = selfTradePrevention == SelfTradePrevention::CANCEL_NEWEST ||
+                            selfTradePrevention == SelfTradePrevention::CANCEL_BOTH;
+    bool cancelResting = selfTradePrevention == SelfTradePrevention::CANCEL_OLDEST ||
+                         selfTradePrevention == SelfTradePrevention::CANCEL_BOTH;
+
+    if (selfTradePrevention == SelfTradePrevention::DECREMENT) {
+        // Like an in-place size down, an iceberg loses its reserve before its displayed slice.
+        const Qty decrement = std::min(aggressiveOrder->quantity, restingOrder->quantity + restingHidden);
+        const Qty fromReserve = std::min(decrement, restingHidden);
+        cancelAggressive = decrement == aggressiveOrder->quantity;
+        cancelResting = decrement == restingOrder->quantity + restingHidden;
+        if (!cancelAggressive) {
+            aggressiveOrder->quantity -= decrement;
+            publishSelfTrade(aggressiveOrder, decrement, false);
+        }
+        if (!cancelResting) {
+            restingInfo.hiddenQuantity -= fromReserve;
+            level->hiddenQuantity -= fromReserve;
+            restingOrder->quantity -= decrement - fromReserve;
+            level->totalQuantity -= decrement - fromReserve;
+            publishSelfTrade(restingOrder, decrement, false);
+        }
+    }
+
+    if (cancelResting) {
+        publishSelfTrade(restingOrder, restingOrder->quantity + restingHidden, true);
+        level->totalQuantity -= restingOrder->quantity;
+        level->hiddenQuantity -= restingHidden;
+        restingOrder->quantity = 0;
+        if (restingOrder->isIceberg) {
+            restingInfo.hiddenQuantity = 0;
+        }
+    }
+    if (cancelAggressive) {
+        publishSelfTrade(aggressiveOrder, aggressiveOrder->quantity, true);
+        aggressiveOrder->quantity = 0;
+    }
+    return cancelResting;
+}
+
+void OrderBook::publishSelfTrade(const Order* order, Qty quantity, bool cancelled) {
+    MarketData data = {
+        cancelled ? MarketData::Type::CANCEL : MarketData::Type::MODIFY,
+        tickerId,
+        order->clientId,
+        order->clientOrderId,
+        0, 0,
+        order->side == Side::BUY ? 'B' : 'S',
+        order->price,
+        cancelled ? quantity : displayedQuantity(order),
+        "Self-trade"
+    };
+    data.aggressiveMarketOrderId = order->marketOrderId;
+    data.aggressiveRemaining = cancelled ? 0 : displayedQuantity(order);
+    publish(data);
+}
+
 void OrderBook::executeMatch(Order* aggressiveOrder, Order* passiveOrder, Qty matchQty, Price matchPrice) {
     // Update order quantities
     aggressiveOrder->quantity -= matchQty;
     passiveOrder->quantity -= matchQty;
+    tradeHigh = std::max(tradeHigh, matchPrice);
+    tradeLow = std::min(tradeLow, matchPrice);
+    lastTradePrice = matchPrice;
 
     // Enqueue the trade execution data
     MarketData data = {
@@ -115,32 +849,21 @@ void OrderBook::executeMatch(Order* aggressiveOrder, Order* passiveOrder, Qty ma
         matchQty,
         "" 
     };
-    marketDataQueue->enqueue(data);
-
-    Side passiveSide = passiveOrder->side;
-    if (passiveSide == Side::BUY) {
-        auto it = buyOrders.find(passiveOrder->price);
-        if (it != buyOrders.end()) {
-            it->second->totalQuantity -= matchQty;
-            if (it->second->totalQuantity == 0) {
-                buyOrders.erase(it);
-            }
-        }
-    } else {
-        auto it = sellOrders.find(passiveOrder->price);
-        if (it != sellOrders.end()) {
-            it->second->totalQuantity -= matchQty;
-            if (it->second->totalQuantity == 0) {
-                sellOrders.erase(it);
-            }
-        }
+    data.aggressiveMarketOrderId = aggressiveOrder->marketOrderId;
+    data.passiveMarketOrderId = passiveOrder->marketOrderId;
+    data.aggressiveRemaining = displayedQuantity(aggressiveOrder);
+    data.passiveRemaining = passiveOrder->quantity;
+    if (fillFeed) {
+        fillFeed->trade(FillRecord{MarketData::Type::TRADE, tickerId, data.aggressiveClientId, data.passiveClientId,
+                                   data.side, matchPrice, matchQty});
     }
-    publishTopOfBook(aggressiveOrder, true);
+    publish(data);
 }
 
-bool OrderBook::cancelOrder(ClientId clientId, OrderId clientOrderId) {
-    auto it = clientOrderMap.find(clientOrderId);
-    if (it == clientOrderMap.end()) {
+bool OrderBook::cancelOrder(ClientId clientId, OrderId clientOrderId, OrderHandle handle) {
+    BookUpdateScope scope(*this);
+    Order* orderPtr = resolve(handle);
+    if (!orderPtr || orderPtr->clientId != clientId || orderPtr->clientOrderId != clientOrderId) {
         // Enqueue the "not found" cancel order data
         MarketData data = {
             MarketData::Type::CANCEL,
@@ -153,149 +876,677 @@ bool OrderBook::cancelOrder(ClientId clientId, OrderId clientOrderId) {
             0,    // quantity unknown
             "Not found"
         };
-        marketDataQueue->enqueue(data);
+        publish(data);
+        return false;
+    }
+
+    withdrawOrder(orderPtr, "");
+    // The touch may have moved enough for opposite pegs to overlap.
+    releaseTriggeredStops();
+    return true;
+}
+
+bool OrderBook::expireGoodTillDate(OrderHandle handle) {
+    BookUpdateScope scope(*this);
+    Order* order = resolve(handle);
+    if (!order) {
         return false;
     }
+    withdrawOrder(order, "Expired");
+    releaseTriggeredStops();
+    return true;
+}
 
-    Order* orderPtr = it->second.first;
-    Side side = it->second.second;
+std::size_t OrderBook::massCancel(ClientId clientId, bool buys, bool sells) {
+    BookUpdateScope scope(*this);
+    auto list = ownerLists.find(clientId);
+    if (list == ownerLists.end() || ownerHead(list->second) == OrderInfo::NO_SLOT) {
+        return 0;
+    }
 
-    removeOrderFromBook(orderPtr, side);
+    // Depth is not published per order: each side's top levels are compared before and after instead.
+    if (buys) {
+        snapshotDepth(Side::BUY, buyLevels.best());
+    }
+    if (sells) {
+        snapshotDepth(Side::SELL, sellLevels.best());
+    }
 
-    if (side == Side::BUY) {
-        auto priceIt = buyOrders.find(orderPtr->price);
-        if (priceIt != buyOrders.end() && priceIt->second->orderCount == 0) {
-            buyOrders.erase(priceIt);
+    // Stops are held back until every order is out, so nothing the walk has yet to reach can trade away.
+    std::size_t cancelled = 0;
+    for (auto slot = ownerHead(list->second); slot != OrderInfo::NO_SLOT;) {
+        Order* order = orderPool.at(slot);
+        slot = orderInfo[slot].ownerNext;
+        if (order->side == Side::BUY ? buys : sells) {
+            withdrawOrder(order, "Mass cancel", false);
+            ++cancelled;
+        }
+    }
+
+    if (buys) {
+        publishDepthChanges(Side::BUY, buyLevels.best());
+    }
+    if (sells) {
+        publishDepthChanges(Side::SELL, sellLevels.best());
+    }
+    releaseTriggeredStops();
+    return cancelled;
+}
+
+/// Take a live order out of wherever it waits and report it cancelled with the given message. The caller
+/// releases any stops or pegs the move of the touch sets off, and publishes the depth deltas itself when it
+/// passes publishDeltas false.
+void OrderBook::withdrawOrder(Order* orderPtr, const char* message, bool publishDeltas) {
+    Side side = orderPtr->side;
+    const Qty openQuantity = orderPtr->quantity;
+
+    const bool wasStop = infoOf(orderPtr).stopPending;
+    const bool wasPeg = infoOf(orderPtr).pegType != PegType::NONE;
+    bool buried = false;
+    if (wasStop) {
+        if (side == Side::BUY) {
+            removeStop(orderPtr, buyStops);
+        } else {
+            removeStop(orderPtr, sellStops);
         }
+    } else if (wasPeg) {
+        removePeg(orderPtr);
     } else {
-        auto priceIt = sellOrders.find(orderPtr->price);
-        if (priceIt != sellOrders.end() && priceIt->second->orderCount == 0) {
-            sellOrders.erase(priceIt);
+        buried = buryOrder(orderPtr, publishDeltas);
+        if (!buried) {
+            removeOrderFromBook(orderPtr, side, publishDeltas);
         }
     }
 
     MarketData data = {
         MarketData::Type::CANCEL,
         tickerId,
-        clientId,
-        clientOrderId,
+        orderPtr->clientId,
+        orderPtr->clientOrderId,
         0, 0,
         side == Side::BUY ? 'B' : 'S',
         orderPtr->price,
-        orderPtr->quantity,
-        ""
+        openQuantity,
+        message
     };
-    marketDataQueue->enqueue(data);
+    data.aggressiveMarketOrderId = orderPtr->marketOrderId;
+    publish(data);
 
-    publishTopOfBook(orderPtr, false);
+    if (!wasStop && !wasPeg) {
+        markTopOfBook(orderPtr);
+    }
 
-    orderPool.deallocate(orderPtr);
+    if (buried) {
+        // The order is gone as far as anyone holding a handle can tell; its slot waits for the tombstone to go.
+        retireOrder(orderPtr);
+        tombstones.push_back(handleOf(orderPtr));
+    } else {
+        releaseOrder(orderPtr);
+    }
+}
 
+/// Take a resting order off its level, retiring the level if that was its last order.
+void OrderBook::removeOrderFromBook(Order* order, Side side, bool publishDeltas) {
+    if (side == Side::BUY) {
+        removeOrderFromLevel(order, buyLevels, publishDeltas);
+    } else {
+        removeOrderFromLevel(order, sellLevels, publishDeltas);
+    }
+}
+
+template<typename Ladder>
+void OrderBook::removeOrderFromLevel(Order* order, Ladder& levels, bool publishDeltas) {
+    noteAuctionChange(Ladder::SIDE, order->price);
+    auto level = levels.find(order->price);
+    level->removeOrderFromLevel(order);
+    if (order->isIceberg) {
+        level->hiddenQuantity -= infoOf(order).hiddenQuantity;
+        infoOf(order).hiddenQuantity = 0;
+    }
+    const auto rank = publishDeltas ? depthRank(level) : depthLevels;
+    if (level->orderCount > 0) {
+        if (rank < depthLevels) {
+            publishDepth(Ladder::SIDE, MarketData::DepthAction::CHANGE, rank, level->price, level->totalQuantity);
+        }
+        return;
+    }
+
+    const Price price = level->price;
+    if (level->deadOrders > 0) {
+        discardDeadOrders(level);
+    }
+    levels.erase(level);
+    if (rank < depthLevels) {
+        publishDepth(Ladder::SIDE, MarketData::DepthAction::DELETE, rank, price, 0);
+        publishDepthTail(Ladder::SIDE, levels.best(), 1);
+    }
+}
+
+/// Lazy cancel of a resting limit order: take it out of its level's totals and leave it queued as a
+/// tombstone. The last live order of a level is never buried, so a level in the ladder always has something
+/// to trade; it is removed as usual, and its level with it. Returns false when the caller must remove the order.
+bool OrderBook::buryOrder(Order* order, bool publishDeltas) {
+    if (!lazyCancels || tombstones.size() >= MAX_TOMBSTONES) {
+        return false;
+    }
+    auto level = order->side == Side::BUY ? buyLevels.find(order->price) : sellLevels.find(order->price);
+    if (level->orderCount == 1) {
+        return false;
+    }
+    if (order->isIceberg) {
+        level->hiddenQuantity -= infoOf(order).hiddenQuantity;
+        infoOf(order).hiddenQuantity = 0;
+    }
+    level->buryOrder(order);
+    noteAuctionChange(order->side, order->price);
+    if (const auto rank = publishDeltas ? depthRank(level) : depthLevels; rank < depthLevels) {
+        publishDepth(order->side, MarketData::DepthAction::CHANGE, rank, level->price, level->totalQuantity);
+    }
     return true;
 }
 
+/// Unlink and free every tombstone of a level. Resting orders always have quantity left, so a tombstone is
+/// any order with none.
+void OrderBook::discardDeadOrders(OrdersAtPrice* level) {
+    for (auto order = level->firstOrder; order && level->deadOrders > 0;) {
+        auto nextOrder = order->nextOrder;
+        if (order->quantity == 0) {
+            level->unlinkOrder(order);
+            --level->deadOrders;
+            releaseOrder(order);
+        }
+        order = nextOrder;
+    }
+}
 
-void OrderBook::removeOrderFromBook(Order* order, Side side) {
-    if (side == Side::BUY) {
-        auto it = buyOrders.find(order->price);
-        if (it != buyOrders.end()) {
-            it->second->removeOrderFromLevel(order);
+std::size_t OrderBook::compactTombstones(std::size_t budget) {
+    for (std::size_t i = 0; i < budget && !tombstones.empty(); ++i) {
+        const auto handle = tombstones.back();
+        tombstones.pop_back();
+        // A stale handle means matching or a retired level has already freed the order.
+        if (auto order = resolve(handle)) {
+            auto level = order->side == Side::BUY ? buyLevels.find(order->price) : sellLevels.find(order->price);
+            level->unlinkOrder(order);
+            --level->deadOrders;
+            releaseOrder(order);
         }
+    }
+    return tombstones.size();
+}
+
+void OrderBook::releaseOrder(Order* order) {
+    retireOrder(order);
+    orderPool.deallocate(order);
+}
+
+/// Make every handle to the order stale and take it off its client's list; the pool slot stays taken.
+void OrderBook::retireOrder(Order* order) {
+    auto& info = infoOf(order);
+    ++info.generation;
+    if (info.ownerList != OrderInfo::NO_OWNER_LIST) {
+        untrackOwner(order);
+    }
+}
+
+/// Link an order into its client's list the first time it rests; later re-rests find it already there.
+void OrderBook::trackOwner(Order* order) {
+    auto& info = infoOf(order);
+    if (info.ownerList != OrderInfo::NO_OWNER_LIST) {
+        return;
+    }
+    auto [it, inserted] = ownerLists.try_emplace(order->clientId, static_cast<uint32_t>(ownerHeads.size()));
+    if (inserted) {
+        ownerHeads.emplace_back();
+    }
+    const auto slot = static_cast<uint32_t>(orderPool.indexOf(order));
+    const auto next = ownerHead(it->second);
+    info.ownerList = it->second;
+    info.ownerPrev = OrderInfo::NO_SLOT;
+    info.ownerNext = next;
+    if (next != OrderInfo::NO_SLOT) {
+        orderInfo[next].ownerPrev = slot;
+    }
+    ownerHeads[it->second] = {slot, orderPool.epoch()};
+}
+
+void OrderBook::untrackOwner(Order* order) {
+    auto& info = infoOf(order);
+    if (info.ownerPrev != OrderInfo::NO_SLOT) {
+        orderInfo[info.ownerPrev].ownerNext = info.ownerNext;
     } else {
-        auto it = sellOrders.find(order->price);
-        if (it != sellOrders.end()) {
-            it->second->removeOrderFromLevel(order);
-        }
+        ownerHeads[info.ownerList].slot = info.ownerNext;
     }
-    
-    auto clientIt = clientOrderMap.find(order->clientOrderId);
-    if (clientIt != clientOrderMap.end()) {
-        clientOrderMap.erase(clientIt);
+    if (info.ownerNext != OrderInfo::NO_SLOT) {
+        orderInfo[info.ownerNext].ownerPrev = info.ownerPrev;
     }
-    
-    orderMap.erase(order->marketOrderId);
+    info.ownerList = OrderInfo::NO_OWNER_LIST;
 }
 
 void OrderBook::removePriceLevel(Side side, Price price) {
     if (side == Side::BUY) {
-        buyOrders.erase(price);
+        if (auto level = buyLevels.find(price)) {
+            buyLevels.erase(level);
+        }
     } else {
-        sellOrders.erase(price);
-    }
-}
-
-void OrderBook::publishTopOfBook(const Order* order, bool isMatch) {
-    Side sideToCheck = isMatch ? (order->side == Side::BUY ? Side::SELL : Side::BUY) : order->side;
-
-    if (sideToCheck == Side::BUY) {
-        auto it = buyOrders.begin();
-        if (it != buyOrders.end()) {
-            if (isMatch || order->price >= it->first) {
-                MarketData data = {
-                    MarketData::Type::BOOK_UPDATE,
-                    tickerId,
-                    0, 0, 0, 0,
-                    'B',
-                    it->first,
-                    it->second->totalQuantity,
-                    ""
-                };
-                marketDataQueue->enqueue(data);
-            }
-        } else {
-            MarketData data = {
-                MarketData::Type::BOOK_UPDATE,
-                tickerId,
-                0, 0, 0, 0,
-                'B',
-                0,
-                0,
-                "B, B, -, -"
-            };
-            marketDataQueue->enqueue(data);
+        if (auto level = sellLevels.find(price)) {
+            sellLevels.erase(level);
         }
+    }
+}
+
+void OrderBook::markTopOfBook(const Order* order) {
+    const OrdersAtPrice* best = order->side == Side::BUY ? buyLevels.best() : sellLevels.best();
+    if (best && ((order->side == Side::BUY && order->price < best->price) ||
+                 (order->side == Side::SELL && order->price > best->price))) {
+        return;
+    }
+    markSideDirty(order->side);
+}
+
+void OrderBook::publishLevel(Side side, const OrdersAtPrice* level) {
+    auto& published = publishedTop[static_cast<int>(side)];
+    const Price price = level ? level->price : 0;
+    const Qty quantity = level ? level->totalQuantity : 0;
+    if (published.price == price && published.quantity == quantity) {
+        return;
+    }
+    published = {price, quantity};
+
+    const char sideChar = side == Side::BUY ? 'B' : 'S';
+    if (level) {
+        MarketData data = {
+            MarketData::Type::BOOK_UPDATE,
+            tickerId,
+            0, 0, 0, 0,
+            sideChar,
+            level->price,
+            level->totalQuantity,
+            ""
+        };
+        publish(data);
     } else {
-        auto it = sellOrders.begin();
-        if (it != sellOrders.end()) {
-            if (isMatch || order->price <= it->first) {
-                
-                MarketData data = {
-                    MarketData::Type::BOOK_UPDATE,
-                    tickerId,
-                    0, 0, 0, 0,
-                    'S',
-                    it->first,
-                    it->second->totalQuantity,
-                    ""
-                };
-                marketDataQueue->enqueue(data);
+        MarketData data = {
+            MarketData::Type::BOOK_UPDATE,
+            tickerId,
+            0, 0, 0, 0,
+            sideChar,
+            0,
+            0,
+            side == Side::BUY ? "B, B, -, -" : "B, S, -, -"
+        };
+        publish(data);
+    }
+}
+
+/// Every record the book emits goes through here and takes the next per-symbol sequence number.
+void OrderBook::publish(MarketData& data) {
+    data.sequence = nextSequence++;
+    marketDataQueue->enqueue(std::move(data));
+}
+
+void OrderBook::openAuction() {
+    BookUpdateScope scope(*this);
+    if (auctionOpen) {
+        return;
+    }
+    auctionOpen = true;
+    auctionChanged = true;
+    publishedIndicative = {};
+    publishAuction({}, "Open");
+}
+
+void OrderBook::uncrossAuction() {
+    BookUpdateScope scope(*this);
+    if (!auctionOpen) {
+        return;
+    }
+    const auto quote = equilibrium();
+    auctionOpen = false;
+    publishAuction(quote, "Uncross");
+
+    // Both sides are consumed from their best level down, so each is left with a run of emptied levels
+    // and at most one partly filled level, as after a sweep. Trading stops once either side has nothing left
+    // at the uncross price: that is the quote's volume, less whatever self-trade prevention took out.
+    std::size_t emptiedBids = 0;
+    std::size_t emptiedAsks = 0;
+    Price lastBidPrice = 0;
+    Price lastAskPrice = 0;
+    while (quote.volume > 0) {
+        auto bid = buyLevels.best();
+        auto ask = sellLevels.best();
+        if (!bid || !ask || bid->price < quote.price || ask->price > quote.price) {
+            break;
+        }
+        if (bid->deadOrders > 0) {
+            discardDeadOrders(bid);
+        }
+        if (ask->deadOrders > 0) {
+            discardDeadOrders(ask);
+        }
+        auto buy = bid->firstOrder;
+        auto sell = ask->firstOrder;
+        // The later of the two orders is reported as the aggressor.
+        const bool buyIsNewer = buy->marketOrderId > sell->marketOrderId;
+        if (buy->clientId == sell->clientId && selfTradePrevention != SelfTradePrevention::NONE) [[unlikely]] {
+            preventAuctionSelfTrade(buyIsNewer ? buy : sell, buyIsNewer ? bid : ask,
+                                    buyIsNewer ? sell : buy, buyIsNewer ? ask : bid);
+        } else {
+            const auto matchQty = std::min(buy->quantity, sell->quantity);
+            bid->totalQuantity -= matchQty;
+            ask->totalQuantity -= matchQty;
+            if (buyIsNewer) {
+                executeMatch(buy, sell, matchQty, quote.price);
+            } else {
+                executeMatch(sell, buy, matchQty, quote.price);
+            }
+        }
+        lastBidPrice = bid->price;
+        lastAskPrice = ask->price;
+        settleAuctionFill(buy, bid, buyLevels, emptiedBids);
+        settleAuctionFill(sell, ask, sellLevels, emptiedAsks);
+    }
+    if (quote.volume > 0) {
+        markSideDirty(Side::BUY);
+        markSideDirty(Side::SELL);
+        publishAuctionDepth(buyLevels, lastBidPrice, emptiedBids);
+        publishAuctionDepth(sellLevels, lastAskPrice, emptiedAsks);
+    }
+    releaseTriggeredStops();
+}
+
+/// Self-trade prevention between the heads of two levels in an uncross, with the newer order playing the
+/// aggressor. Both orders rest, so the newer one's level totals are settled here too; an iceberg is treated as
+/// its whole open quantity, then split again into a slice and a reserve if any of it is left.
+void OrderBook::preventAuctionSelfTrade(Order* newer, OrdersAtPrice* newerLevel, Order* older, OrdersAtPrice* olderLevel) {
+    auto& info = infoOf(newer);
+    if (newer->isIceberg && info.hiddenQuantity > 0) {
+        newer->quantity += info.hiddenQuantity;
+        newerLevel->totalQuantity += info.hiddenQuantity;
+        newerLevel->hiddenQuantity -= info.hiddenQuantity;
+        info.hiddenQuantity = 0;
+    }
+    const Qty before = newer->quantity;
+    preventSelfTrade(newer, older, olderLevel);
+    newerLevel->totalQuantity -= before - newer->quantity;
+    if (newer->isIceberg && newer->quantity > info.displayQuantity) {
+        info.hiddenQuantity = newer->quantity - info.displayQuantity;
+        newerLevel->hiddenQuantity += info.hiddenQuantity;
+        newerLevel->totalQuantity -= info.hiddenQuantity;
+        newer->quantity = info.displayQuantity;
+    }
+}
+
+template<typename Ladder>
+void OrderBook::settleAuctionFill(Order* order, OrdersAtPrice* level, Ladder& levels, std::size_t& emptiedLevels) {
+    if (order->quantity > 0) {
+        return;
+    }
+    settleFill(order, level);
+    if (level->orderCount == 0) {
+        if (emptiedLevels < depthLevels) {
+            publishDepth(Ladder::SIDE, MarketData::DepthAction::DELETE, 0, level->price, 0);
+        }
+        ++emptiedLevels;
+        levels.erase(level);
+    }
+}
+
+/// Depth deltas for one side after an uncross: the deletes were sent as levels emptied, so what is left is
+/// the new size of the level that was last traded, if it survived, and the levels that moved into view.
+template<typename Ladder>
+void OrderBook::publishAuctionDepth(Ladder& levels, Price lastFilledPrice, std::size_t emptiedLevels) {
+    const auto best = levels.best();
+    if (best && best->price == lastFilledPrice && emptiedLevels < depthLevels) {
+        publishDepth(Ladder::SIDE, MarketData::DepthAction::CHANGE, 0, best->price, best->totalQuantity);
+    }
+    if (emptiedLevels > 0 && depthLevels > 0) {
+        publishDepthTail(Ladder::SIDE, levels.best(), emptiedLevels);
+    }
+}
+
+/// Equilibrium over the prices where the book crosses. Only level prices are candidates, since executable
+/// volume only changes at them. Ties on volume and surplus go to the highest price under buy pressure,
+/// otherwise to the lowest.
+OrderBook::AuctionQuote OrderBook::equilibrium() {
+    const auto bestBid = buyLevels.best();
+    const auto bestAsk = sellLevels.best();
+    if (!bestBid || !bestAsk || bestBid->price < bestAsk->price) {
+        return {};
+    }
+    const Price low = bestAsk->price;
+    const Price high = bestBid->price;
+
+    // Merge the crossing level prices of both sides into one ascending list. Asks are linked ascending,
+    // bids descending, so the bids are walked from their deepest crossing level up.
+    auctionPrices.clear();
+    auto bid = bestBid;
+    while (bid->nextLevel && bid->nextLevel->price >= low) {
+        bid = bid->nextLevel;
+    }
+    auto ask = bestAsk;
+    while (ask && ask->price <= high) {
+        while (bid && bid->price < ask->price) {
+            auctionPrices.push_back(bid->price);
+            bid = bid->prevLevel;
+        }
+        if (bid && bid->price == ask->price) {
+            bid = bid->prevLevel;
+        }
+        auctionPrices.push_back(ask->price);
+        ask = ask->nextLevel;
+    }
+    for (; bid; bid = bid->prevLevel) {
+        auctionPrices.push_back(bid->price);
+    }
+
+    // Cumulative volume: asks at or below each candidate, bids at or above it. Hidden reserves trade too.
+    const auto count = auctionPrices.size();
+    auctionBidVolume.resize(count);
+    auctionAskVolume.resize(count);
+    int64_t askVolume = 0;
+    ask = bestAsk;
+    for (std::size_t i = 0; i < count; ++i) {
+        for (; ask && ask->price <= auctionPrices[i]; ask = ask->nextLevel) {
+            askVolume += ask->totalQuantity + ask->hiddenQuantity;
+        }
+        auctionAskVolume[i] = askVolume;
+    }
+    int64_t bidVolume = 0;
+    bid = bestBid;
+    for (std::size_t i = count; i-- > 0;) {
+        for (; bid && bid->price >= auctionPrices[i]; bid = bid->nextLevel) {
+            bidVolume += bid->totalQuantity + bid->hiddenQuantity;
+        }
+        auctionBidVolume[i] = bidVolume;
+    }
+
+    // Branch-free passes over the volume arrays, so they vectorize: the largest executable volume, then the
+    // smallest surplus among the prices reaching it.
+    const int64_t* bids = auctionBidVolume.data();
+    const int64_t* asks = auctionAskVolume.data();
+    int64_t bestVolume = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        bestVolume = std::max(bestVolume, std::min(bids[i], asks[i]));
+    }
+    constexpr int64_t NOT_EXECUTABLE = std::numeric_limits<int64_t>::max();
+    int64_t bestSurplus = NOT_EXECUTABLE;
+    for (std::size_t i = 0; i < count; ++i) {
+        const int64_t volume = bids[i] < asks[i] ? bids[i] : asks[i];
+        const int64_t surplus = std::abs(bids[i] - asks[i]) | (volume == bestVolume ? 0 : NOT_EXECUTABLE);
+        bestSurplus = surplus < bestSurplus ? surplus : bestSurplus;
+    }
+
+    std::size_t chosen = count;
+    for (std::size_t i = 0; i < count; ++i) {
+        const bool tied = std::min(bids[i], asks[i]) == bestVolume &&
+                          std::abs(bids[i] - asks[i]) == bestSurplus;
+        if (tied && (chosen == count || bids[i] > asks[i])) {
+            chosen = i;     // the lowest tie, or a higher one while buyers are left over
+        }
+    }
+    return {auctionPrices[chosen], std::min(bids[chosen], asks[chosen]), bids[chosen] - asks[chosen]};
+}
+
+/// The volume is capped at the largest quantity a record carries.
+void OrderBook::publishAuction(const AuctionQuote& quote, const char* message) {
+    MarketData data = {
+        MarketData::Type::AUCTION,
+        tickerId,
+        0, 0, 0, 0,
+        quote.surplus > 0 ? 'B' : quote.surplus < 0 ? 'S' : '-',
+        quote.price,
+        static_cast<Qty>(std::min<int64_t>(quote.volume, std::numeric_limits<Qty>::max())),
+        message
+    };
+    publish(data);
+}
+
+void OrderBook::flushBookUpdates() {
+    if (auctionOpen && auctionChanged) {
+        auctionChanged = false;
+        if (const auto quote = equilibrium(); quote != publishedIndicative) {
+            publishedIndicative = quote;
+            publishAuction(quote, "Indicative");
+        }
+    }
+    if (dirtySides & (1u << static_cast<int>(Side::BUY))) {
+        publishLevel(Side::BUY, buyLevels.best());
+    }
+    if (dirtySides & (1u << static_cast<int>(Side::SELL))) {
+        publishLevel(Side::SELL, sellLevels.best());
+    }
+    dirtySides = 0;
+}
+
+/// Position of a level from the best one, capped at depthLevels (anything at or past it is outside the feed).
+std::size_t OrderBook::depthRank(const OrdersAtPrice* level) const {
+    std::size_t rank = 0;
+    for (auto better = level->prevLevel; better && rank < depthLevels; better = better->prevLevel) {
+        ++rank;
+    }
+    return rank;
+}
+
+void OrderBook::publishDepth(Side side, MarketData::DepthAction action, std::size_t rank, Price price, Qty quantity) {
+    MarketData data = {
+        MarketData::Type::DEPTH_UPDATE,
+        tickerId,
+        0, 0, 0, 0,
+        side == Side::BUY ? 'B' : 'S',
+        price,
+        quantity,
+        "",
+        action,
+        static_cast<uint32_t>(rank)
+    };
+    publish(data);
+}
+
+/// After levels inside the published depth were removed, the levels that slid up into its last
+/// removedLevels ranks are new to consumers.
+void OrderBook::publishDepthTail(Side side, const OrdersAtPrice* best, std::size_t removedLevels) {
+    const auto firstNew = removedLevels < depthLevels ? depthLevels - removedLevels : 0;
+    std::size_t rank = 0;
+    for (auto level = best; level && rank < depthLevels; level = level->nextLevel, ++rank) {
+        if (rank >= firstNew) {
+            publishDepth(side, MarketData::DepthAction::NEW, rank, level->price, level->totalQuantity);
+        }
+    }
+}
+
+void OrderBook::snapshotDepth(Side side, const OrdersAtPrice* best) {
+    auto& levels = depthBefore[static_cast<int>(side)];
+    levels.clear();
+    for (auto level = best; level && levels.size() < depthLevels; level = level->nextLevel) {
+        levels.emplace_back(level->price, level->totalQuantity);
+    }
+}
+
+/// Deltas from the snapshot to the side's current top levels, for changes that only removed quantity:
+/// a level is either still there, smaller or not, or gone, and levels from further down move into view.
+void OrderBook::publishDepthChanges(Side side, const OrdersAtPrice* best) {
+    std::size_t rank = 0;
+    auto level = best;
+    for (const auto& [price, quantity] : depthBefore[static_cast<int>(side)]) {
+        if (level && level->price == price) {
+            if (level->totalQuantity != quantity) {
+                publishDepth(side, MarketData::DepthAction::CHANGE, rank, price, level->totalQuantity);
             }
+            ++rank;
+            level = level->nextLevel;
         } else {
-            MarketData data = {
-                MarketData::Type::BOOK_UPDATE,
-                tickerId,
-                0, 0, 0, 0,
-                'S',
-                0,
-                0,
-                "B, S, -, -"
-            };
-            marketDataQueue->enqueue(data);
+            publishDepth(side, MarketData::DepthAction::DELETE, rank, price, 0);
         }
     }
+    for (; level && rank < depthLevels; level = level->nextLevel, ++rank) {
+        publishDepth(side, MarketData::DepthAction::NEW, rank, level->price, level->totalQuantity);
+    }
+}
+
+void OrderBook::setDepthLevels(std::size_t levels) {
+    depthLevels = levels;
+}
+
+void OrderBook::setMatchingPolicy(MatchingPolicy policy) {
+    matchingPolicy = policy;
+}
+
+void OrderBook::setSelfTradePrevention(SelfTradePrevention mode) {
+    selfTradePrevention = mode;
+}
+
+void OrderBook::setLazyCancels(bool enabled) {
+    lazyCancels = enabled;
+}
+
+void OrderBook::setFillFeed(FillFeed* feed) {
+    fillFeed = feed;
 }
 
 void OrderBook::setTickerId(TickerId id) {
     this->tickerId = id;
 }
 
+/// Nothing is visited: both pools are released whole, the ladders' occupancy bitmaps start a new epoch, and
+/// orderInfo entries and client list heads are recognised as stale by their order pool epoch when next used.
 void OrderBook::reset() {
     nextOrderId = 1;
-    buyOrders.clear();
-    sellOrders.clear();
-    orderMap.clear();
-    clientOrderMap.clear();
+    nextSequence = 1;
+    dirtySides = 0;
+    publishedTop[0] = publishedTop[1] = PublishedTop{};
+    buyLevels.forgetAll();
+    sellLevels.forgetAll();
+    buyStops.forgetAll();
+    sellStops.forgetAll();
+    orderPool.releaseAll();
+    levelPool.releaseAll();
+    for (auto& queues : pegQueues) {
+        for (auto& queue : queues) {
+            queue = OrdersAtPrice{};
+        }
+    }
+    restingPegs[0] = restingPegs[1] = 0;
+    auctionOpen = false;
+    auctionChanged = false;
+    publishedIndicative = {};
+    tombstones.clear();
+    tradeHigh = std::numeric_limits<Price>::min();
+    tradeLow = std::numeric_limits<Price>::max();
+    lastTradePrice = 0;
+}
+
+Price OrderBook::referencePrice() const {
+    if (lastTradePrice != 0) {
+        return lastTradePrice;
+    }
+    const auto bestBid = buyLevels.best();
+    const auto bestAsk = sellLevels.best();
+    return bestBid && bestAsk ? bestBid->price + (bestAsk->price - bestBid->price) / 2 : 0;
 }
 
-template void OrderBook::matchOrder<OrderBook::BuyOrderMap>(Order* order, OrderBook::BuyOrderMap::iterator begin, OrderBook::BuyOrderMap::iterator end);
-template void OrderBook::matchOrder<OrderBook::SellOrderMap>(Order* order, OrderBook::SellOrderMap::iterator begin, OrderBook::SellOrderMap::iterator end);
\ No newline at end of file
+template void OrderBook::matchOrder<MatchingPolicy::FIFO, OrderBook::BuyLadder>(Order* order, OrderBook::BuyLadder& levels);
+template void OrderBook::matchOrder<MatchingPolicy::FIFO, OrderBook::SellLadder>(Order* order, OrderBook::SellLadder& levels);
+template void OrderBook::matchOrder<MatchingPolicy::PRO_RATA, OrderBook::BuyLadder>(Order* order, OrderBook::BuyLadder& levels);
+template void OrderBook::matchOrder<MatchingPolicy::PRO_RATA, OrderBook::SellLadder>(Order* order, OrderBook::SellLadder& levels);
+template void OrderBook::matchOrder<MatchingPolicy::TOP_ORDER_PRO_RATA, OrderBook::BuyLadder>(Order* order, OrderBook::BuyLadder& levels);
+template void OrderBook::matchOrder<MatchingPolicy::TOP_ORDER_PRO_RATA, OrderBook::SellLadder>(Order* order, OrderBook::SellLadder& levels);
\ No newline at end of file
@@ -1,82 +1,390 @@
 #pragma once
 
-#include <boost/container/flat_map.hpp>
-#include <unordered_map>
+#include <limits>
+#include <span>
+#include <vector>
 #include "Types.h"
 #include "OrdersAtPrice.h"
+#include "PriceLadder.h"
 #include "Order.h"
 #include "utils/concurrentqueue.h"
 #include "market_publisher/market_data.h"
 #include "OptMemPool.h"
-#include "robin_hood.h" 
+#include "credit_risk.h"
+#include "robin_hood.h"
+
+/// One order-entry instruction for OrderBook::applyBatch.
+struct BookCommand {
+    enum class Type : uint8_t { ADD, CANCEL, MODIFY, STOP, PEG, OPEN_AUCTION, UNCROSS, EXPIRE };
+
+    Type type = Type::ADD;
+    ClientId clientId = 0;
+    OrderId clientOrderId = 0;
+    Side side = Side::BUY;      // ADD, STOP and PEG
+    Price price = 0;            // ADD, MODIFY and STOP (the limit, 0 for a stop-market order)
+    Qty quantity = 0;           // ADD, MODIFY, STOP and PEG
+    TimeInForce timeInForce = TimeInForce::DAY;     // ADD only
+    Qty displayQuantity = 0;    // ADD only, 0 when the whole order is displayed
+    Price triggerPrice = 0;     // STOP only
+    PegType pegType = PegType::NONE;    // PEG only
+    OrderHandle handle = {};        // in: the target order for CANCEL/MODIFY/EXPIRE; out: the order's handle if it rests afterwards
+};
 
 class OrderBook {
 public:
-    using BuyOrderMap = boost::container::flat_map<Price, std::unique_ptr<OrdersAtPrice>, std::greater<Price>>;
-    using SellOrderMap = boost::container::flat_map<Price, std::unique_ptr<OrdersAtPrice>, std::less<Price>>;
+    using BuyLadder = PriceLadder<Side::BUY>;
+    using SellLadder = PriceLadder<Side::SELL>;
+    // Trigger books: buy stops fire from the lowest trigger up, sell stops from the highest down.
+    using BuyStopLadder = PriceLadder<Side::SELL>;
+    using SellStopLadder = PriceLadder<Side::BUY>;
 
-    OrderBook(TickerId id, moodycamel::ConcurrentQueue<MarketData>* marketDataQueue, std::size_t initialPoolSize);
-    ~OrderBook();
-    
-    void addOrder(ClientId clientId, OrderId clientOrderId, Side side, Price price, Qty quantity);
-    bool cancelOrder(ClientId clientId, OrderId clientOrderId);
+    OrderBook(TickerId id, moodycamel::ConcurrentQueue<MarketData>* marketDataQueue, std::size_t initialPoolSize,
+              std::size_t priceBandTicks = DEFAULT_PRICE_BAND_TICKS);
+    /// Returns a handle to the order if any of it rests in the book, an invalid handle otherwise.
+    /// IOC and FOK remainders never rest; they are reported as a CANCEL once matching is done.
+    /// A displayQuantity below quantity makes an iceberg: only slices of that size are displayed, and each
+    /// slice traded away is replenished from the reserve at the back of the queue.
+    OrderHandle addOrder(ClientId clientId, OrderId clientOrderId, Side side, Price price, Qty quantity,
+                         TimeInForce timeInForce = TimeInForce::DAY, Qty displayQuantity = 0);
+    bool cancelOrder(ClientId clientId, OrderId clientOrderId, OrderHandle handle);
+    /// Cancel a good-till-date order whose expiry has passed, reported with the message Expired. The book
+    /// keeps no clock; the caller decides when. A stale handle means the order has already left the book:
+    /// nothing is published and false is returned.
+    bool expireGoodTillDate(OrderHandle handle);
+    /// Cancel every order the client has in this book (stops and pegs included) on the chosen sides, walking
+    /// only that client's orders. Each is reported as a CANCEL with the message Mass cancel; the depth feed
+    /// gets one set of deltas per side and the top of book one update. Returns the number cancelled.
+    std::size_t massCancel(ClientId clientId, bool buys, bool sells);
+    /// Amend price and/or remaining quantity. A size-down at the same price is applied in place and keeps
+    /// priority; anything else re-inserts the order, which may trade. Returns the order's handle while it rests.
+    OrderHandle modifyOrder(ClientId clientId, OrderId clientOrderId, OrderHandle handle, Price price, Qty quantity);
+    /// Park a stop (limitPrice 0) or stop-limit order until a trade prints at or through triggerPrice, then
+    /// enter it as a new day order. Returns the order's handle, which stays valid if it rests once triggered.
+    OrderHandle addStopOrder(ClientId clientId, OrderId clientOrderId, Side side, Price triggerPrice, Price limitPrice,
+                             Qty quantity);
+    /// Rest a pegged order in its side's peg queue. Its price is never stored: each match reads it off the
+    /// displayed best bid and offer, so a move of the touch reprices every peg without touching one of them.
+    /// Pegs are not displayed and never cross the displayed book; they trade after the displayed orders at
+    /// the same price, and against opposite pegs when a move of the touch makes the two overlap.
+    OrderHandle addPegOrder(ClientId clientId, OrderId clientOrderId, Side side, PegType pegType, Qty quantity);
+    /// Start a call auction. Until it is uncrossed, limit orders rest without matching, market, IOC and FOK
+    /// orders are rejected, and an indicative uncross price is published whenever it moves.
+    void openAuction();
+    /// Trade everything that crosses at the price that maximizes executed volume, in price-time priority,
+    /// then return the book to continuous matching.
+    void uncrossAuction();
+    /// Apply a burst of commands in order. ADD/CANCEL/MODIFY and TRADE records are published as usual, but
+    /// the top-of-book update for each side that changed is published once, after the last command
+    /// rather than after each one.
+    void applyBatch(std::span<BookCommand> commands);
 
 void setTickerId(TickerId id);
 
+/// Publish L2 deltas for the best `levels` price levels of each side; 0 turns the depth feed off.
+/// Set before the book takes orders: consumers only see deltas from that point on.
+void setDepthLevels(std::size_t levels);
+
+/// How each price level's quantity is shared among its resting orders. Set when the book is opened for an
+/// instrument, before it takes orders.
+void setMatchingPolicy(MatchingPolicy policy);
+
+/// How orders that would trade with the same client's resting orders are handled; NONE lets them trade.
+void setSelfTradePrevention(SelfTradePrevention mode);
+
+/// Lazy cancels: a cancelled limit order that is not the last on its level is only taken out of the level's
+/// totals and left in the queue as a tombstone, so the cancel never touches its neighbours or the pool.
+/// Matching drops the tombstones of a level before trading against it; compactTombstones drops the rest.
+void setLazyCancels(bool enabled);
+
+/// Also send every trade to feed, as a FillRecord, the moment it executes (nullptr stops it). The feed's queue
+/// has one producer, so every book writing to it must run on the same thread.
+void setFillFeed(FillFeed* feed);
+
+/// Unlink and free up to budget tombstones and return how many are still waiting. Meant for
+/// the engine's idle time: nothing is published and the book reads the same before and after.
+std::size_t compactTombstones(std::size_t budget);
+bool hasTombstones() const { return !tombstones.empty(); }
+
+/// True while the order the handle was issued for is still in the book, resting, parked as a stop or pegged.
+/// A handle goes stale once its order fills, is cancelled or expires, and on reset.
+bool holds(OrderHandle handle) const;
+
+/// Empty the book for reuse in constant time: orders, levels, ladder slots and client lists are all dropped by
+/// starting a new epoch rather than visited. Only levels priced outside a ladder's widest window are freed one by
+/// one. Nothing is published, and every handle the book has issued goes stale.
 void reset();
 
-template<typename OrderMap>
-void matchOrder(Order* order, typename OrderMap::iterator begin, typename OrderMap::iterator end) {
-    auto it = begin;
-    while (it != end && order->quantity > 0) {
-        auto currentIt = it++; 
-        auto& ordersAtPrice = *(currentIt->second);
-        
-        if (order->price != 0 && 
-            ((order->side == Side::BUY && order->price < ordersAtPrice.price) ||
-             (order->side == Side::SELL && order->price > ordersAtPrice.price))) {
+/// Price new orders are collared against before they reach the engine: the last trade, or the midpoint of the
+/// touch until the book has traded, 0 while it has neither.
+Price referencePrice() const;
+
+/// Single pass over the opposite side: each level is visited once, fills are applied to the level in hand,
+/// and the levels the sweep emptied are retired together once it stops.
+/// The policy decides how a level's quantity is shared out; it is fixed per instantiation, so the fill loop
+/// never branches on it.
+template<MatchingPolicy Policy, typename Ladder>
+void matchOrder(Order* order, Ladder& levels) {
+    const Side passiveSide = Ladder::SIDE;
+    std::size_t emptiedLevels = 0;
+    auto* ordersAtPrice = levels.best();
+    // Pegs are priced once from the touch as it stood when the order arrived. They never rank behind the best
+    // level, so only pegs inside it trade first and the rest queue behind its displayed orders.
+    const PegQuotes pegs = pegQuotes(passiveSide);
+    if (pegs.any) {
+        matchPegs(order, passiveSide, pegs, ordersAtPrice, false);
+    }
+    while (ordersAtPrice && order->quantity > 0) {
+        if (order->price != 0 && Ladder::isBetter(order->price, ordersAtPrice->price)) {
             break;
         }
+        if (ordersAtPrice->deadOrders > 0) [[unlikely]] {
+            discardDeadOrders(ordersAtPrice);
+        }
 
-        auto matchingOrder = ordersAtPrice.firstOrder;
-        while (matchingOrder && order->quantity > 0) {
-            auto matchQty = std::min(order->quantity, matchingOrder->quantity);
-            executeMatch(order, matchingOrder, matchQty, ordersAtPrice.price);
+        if constexpr (Policy == MatchingPolicy::FIFO) {
+            auto matchingOrder = ordersAtPrice->firstOrder;
+            while (matchingOrder && order->quantity > 0) {
+                if (matchingOrder->clientId == order->clientId && selfTradePrevention != SelfTradePrevention::NONE) [[unlikely]] {
+                    markSideDirty(passiveSide);
+                    if (!preventSelfTrade(order, matchingOrder, ordersAtPrice)) {
+                        continue;   // the resting order stays, so the aggressor has nothing left
+                    }
+                    auto cancelledOrder = matchingOrder;
+                    matchingOrder = matchingOrder->nextOrder;
+                    --ordersAtPrice->orderCount;
+                    releaseOrder(cancelledOrder);
+                    continue;
+                }
+                auto matchQty = std::min(order->quantity, matchingOrder->quantity);
+                ordersAtPrice->totalQuantity -= matchQty;
+                executeMatch(order, matchingOrder, matchQty, ordersAtPrice->price);
+                markSideDirty(passiveSide);
 
-            if (matchingOrder->quantity == 0) {
-                auto nextOrder = matchingOrder->nextOrder;
-                removeOrderFromBook(matchingOrder, order->side == Side::BUY ? Side::SELL : Side::BUY);
-                matchingOrder = nextOrder;
-            } else {
+                if (matchingOrder->quantity > 0) {
+                    break;
+                }
+                auto filledOrder = matchingOrder;
                 matchingOrder = matchingOrder->nextOrder;
+                if (filledOrder->isIceberg && replenish(filledOrder, ordersAtPrice)) {
+                    // The new slice went to the back of the queue; if it was alone it is also next in line.
+                    if (!matchingOrder) {
+                        matchingOrder = filledOrder;
+                    }
+                    continue;
+                }
+                --ordersAtPrice->orderCount;
+                releaseOrder(filledOrder);
             }
-        }
 
-        if (ordersAtPrice.orderCount == 0) {
-            if constexpr (std::is_same_v<OrderMap, BuyOrderMap>) {
-                buyOrders.erase(currentIt);
+            // Filled orders are always a prefix of the queue, so the level is trimmed once.
+            ordersAtPrice->firstOrder = matchingOrder;
+            if (matchingOrder) {
+                matchingOrder->prevOrder = nullptr;
             } else {
-                sellOrders.erase(currentIt);
+                ordersAtPrice->lastOrder = nullptr;
             }
+        } else {
+            fillProRata(order, ordersAtPrice, passiveSide, Policy == MatchingPolicy::TOP_ORDER_PRO_RATA);
+        }
+
+        // Every emptied level ranked first when it was swept, so consumers see a run of deletes at index 0.
+        if (ordersAtPrice->firstOrder) {
+            if (emptiedLevels < depthLevels) {
+                publishDepth(passiveSide, MarketData::DepthAction::CHANGE, 0, ordersAtPrice->price, ordersAtPrice->totalQuantity);
+            }
+            break;
+        }
+        if (emptiedLevels < depthLevels) {
+            publishDepth(passiveSide, MarketData::DepthAction::DELETE, 0, ordersAtPrice->price, 0);
         }
+        ++emptiedLevels;
+        if (pegs.any) {
+            matchPegs(order, passiveSide, pegs, ordersAtPrice, true);
+        }
+        ordersAtPrice = ordersAtPrice->nextLevel;
+    }
+    levels.retireBefore(ordersAtPrice);
+    if (emptiedLevels > 0 && depthLevels > 0) {
+        publishDepthTail(passiveSide, levels.best(), emptiedLevels);
     }
 }
     
 private:
     TickerId tickerId;
     OrderId nextOrderId;
+    uint64_t nextSequence;
     moodycamel::ConcurrentQueue<MarketData>* marketDataQueue;
+    FillFeed* fillFeed;
     OptCommon::OptMemPool<Order> orderPool;
+    std::vector<OrderInfo> orderInfo;   // parallel to orderPool
+    LevelPool levelPool;
+
+    BuyLadder buyLevels;
+    SellLadder sellLevels;
+    BuyStopLadder buyStops;
+    SellStopLadder sellStops;
+
+    // Peg queues per side, one per peg type; only the queue's order list and totals are used, not its price.
+    static constexpr std::size_t PEG_TYPES = 3;
+    OrdersAtPrice pegQueues[2][PEG_TYPES];
+    std::size_t restingPegs[2] = {0, 0};
+
+    /// Prices of one side's peg queues for the current touch, 0 where a queue is empty or cannot be priced.
+    struct PegQuotes {
+        Price price[PEG_TYPES];
+        bool any;
+    };
+
+    // Range of trade prices since stops were last checked.
+    Price tradeHigh = std::numeric_limits<Price>::min();
+    Price tradeLow = std::numeric_limits<Price>::max();
+    Price lastTradePrice = 0;
+
+    /// Last top of book published for a side; an empty side is published as price 0, quantity 0.
+    struct PublishedTop {
+        Price price = -1;   // nothing published yet
+        Qty quantity = 0;
+    };
+
+    /// Top-of-book updates are held back while a scope is open. When the outermost scope closes, each side
+    /// dirtied since it opened is published once, and only if its best price or size actually moved.
+    /// Every public operation opens one, so a sweep produces a single update instead of one per fill.
+    class BookUpdateScope {
+    public:
+        explicit BookUpdateScope(OrderBook& b) : book(b), outermost(!b.inUpdateScope) { book.inUpdateScope = true; }
+        ~BookUpdateScope() {
+            if (outermost) {
+                book.inUpdateScope = false;
+                book.flushBookUpdates();
+            }
+        }
+        BookUpdateScope(const BookUpdateScope&) = delete;
+        BookUpdateScope& operator=(const BookUpdateScope&) = delete;
 
-    BuyOrderMap buyOrders;
-    SellOrderMap sellOrders;
-    robin_hood::unordered_map<OrderId, Order*> orderMap;
-    robin_hood::unordered_map<OrderId, std::pair<Order*, Side>> clientOrderMap;
+    private:
+        OrderBook& book;
+        bool outermost;
+    };
+
+    std::size_t depthLevels;    // L2 depth published per side, 0 when the depth feed is off
+    SelfTradePrevention selfTradePrevention;
+    MatchingPolicy matchingPolicy;
+
+    // Lazy cancels. Each tombstone's handle was taken after the cancel bumped its generation, so it goes stale
+    // once matching or a retired level has already freed the order. Past MAX_TOMBSTONES cancels are eager again.
+    static constexpr std::size_t MAX_TOMBSTONES = 4096;
+    bool lazyCancels;
+    std::vector<OrderHandle> tombstones;
+
+    /// Auction equilibrium: the price maximizing executable volume, then minimizing the surplus left on one
+    /// side (positive for buy surplus). Price and volume are 0 while the book does not cross. Volumes are summed
+    /// over whole sides, so they are kept wider than a Qty.
+    struct AuctionQuote {
+        Price price = 0;
+        int64_t volume = 0;
+        int64_t surplus = 0;
+
+        bool operator==(const AuctionQuote&) const = default;
+    };
+    bool auctionOpen;
+    bool auctionChanged;    // a level inside the crossed range changed since the indicative was last computed
+    AuctionQuote publishedIndicative;
+    // Scratch space for the equilibrium: candidate prices ascending with the volume crossing at each.
+    std::vector<Price> auctionPrices;
+    std::vector<int64_t> auctionBidVolume;
+    std::vector<int64_t> auctionAskVolume;
+    // Every order that has rested is linked into its client's list through OrderInfo, so a mass cancel visits
+    // only that client's orders. Lists are numbered in the order clients first rest something and outlive a
+    // reset: a head from an earlier order pool epoch reads as an empty list.
+    struct OwnerHead {
+        uint32_t slot = OrderInfo::NO_SLOT;     // first order's pool slot
+        uint32_t epoch = 0;                     // order pool epoch slot was written in
+    };
+    robin_hood::unordered_flat_map<ClientId, uint32_t> ownerLists;
+    std::vector<OwnerHead> ownerHeads;
+    // Scratch space for a mass cancel: each side's published depth before the first order was withdrawn.
+    std::vector<std::pair<Price, Qty>> depthBefore[2];
+    // Scratch space for pro-rata allocation, kept to avoid allocating per level.
+    std::vector<Order*> allocationOrders;
+    std::vector<Qty> allocationSizes;
+    std::vector<Qty> allocations;
+
+    bool inUpdateScope;
+    uint8_t dirtySides;     // bit per side whose top of book may have changed
+    PublishedTop publishedTop[2];
     
-    void removeOrderFromBook(Order* order, Side side);
-    void publishTopOfBook(const Order* order, bool isMatch = false);
+    OrderInfo& infoOf(const Order* order) { return orderInfo[orderPool.indexOf(order)]; }
+    Order* newOrder(ClientId clientId, OrderId clientOrderId, Side side, Price price, Qty quantity);
+    void publishAdd(const Order* order, const char* message);
+    OrderHandle enterOrder(Order* order, TimeInForce timeInForce);
+    void releaseTriggeredStops();
+    OrdersAtPrice& pegQueue(Side side, PegType type) {
+        return pegQueues[static_cast<int>(side)][static_cast<int>(type) - 1];
+    }
+    Price pegPrice(Side side, PegType type) const;
+    PegQuotes pegQuotes(Side side) const;
+    OrdersAtPrice* bestPeg(Side side, const PegQuotes& quotes, Price& price);
+    void matchPegs(Order* order, Side side, const PegQuotes& quotes, const OrdersAtPrice* level, bool atLevel);
+    bool uncrossPegs();
+    void removePeg(Order* order);
+    template<typename Ladder>
+    void removeStop(Order* order, Ladder& stops);
+    Order* resolve(OrderHandle handle);
+    OrderHandle handleOf(const Order* order) const;
+    void restOrder(Order* order);
+    bool replenish(Order* order, OrdersAtPrice* level);
+    Qty displayedQuantity(const Order* order) { return order->isIceberg ? std::min(order->quantity, infoOf(order).displayQuantity) : order->quantity; }
+    void removeOrderFromBook(Order* order, Side side, bool publishDeltas = true);
+    template<typename Ladder>
+    void removeOrderFromLevel(Order* order, Ladder& levels, bool publishDeltas);
+    bool buryOrder(Order* order, bool publishDeltas);
+    void discardDeadOrders(OrdersAtPrice* level);
+    void releaseOrder(Order* order);
+    void retireOrder(Order* order);
+    void publish(MarketData& data);
+    void markSideDirty(Side side) { dirtySides |= 1u << static_cast<int>(side); }
+    /// Only levels between the best ask and the best bid move the equilibrium, so a change elsewhere leaves
+    /// the indicative as it is. The opposite side's best is read, which a change on this side never moves.
+    void noteAuctionChange(Side side, Price price) {
+        if (auctionOpen) [[unlikely]] {
+            const auto opposite = side == Side::BUY ? sellLevels.best() : buyLevels.best();
+            auctionChanged |= opposite && (side == Side::BUY ? price >= opposite->price : price <= opposite->price);
+        }
+    }
+    void markTopOfBook(const Order* order);
+    void publishLevel(Side side, const OrdersAtPrice* level);
+    void flushBookUpdates();
+    std::size_t depthRank(const OrdersAtPrice* level) const;
+    void publishDepth(Side side, MarketData::DepthAction action, std::size_t rank, Price price, Qty quantity);
+    void publishDepthTail(Side side, const OrdersAtPrice* best, std::size_t removedLevels);
     void removePriceLevel(Side side, Price price);
+    void matchAgainstBook(Order* order);
+    template<typename Ladder>
+    void matchWithPolicy(Order* order, Ladder& levels);
+    void fillProRata(Order* order, OrdersAtPrice* level, Side passiveSide, bool topOrderFirst);
+    void settleFill(Order* restingOrder, OrdersAtPrice* level);
+    AuctionQuote equilibrium();
+    void publishAuction(const AuctionQuote& quote, const char* message);
+    void preventAuctionSelfTrade(Order* newer, OrdersAtPrice* newerLevel, Order* older, OrdersAtPrice* olderLevel);
+    template<typename Ladder>
+    void settleAuctionFill(Order* order, OrdersAtPrice* level, Ladder& levels, std::size_t& emptiedLevels);
+    template<typename Ladder>
+    void publishAuctionDepth(Ladder& levels, Price lastFilledPrice, std::size_t emptiedLevels);
+    void withdrawOrder(Order* order, const char* message, bool publishDeltas = true);
+    uint32_t ownerHead(uint32_t list) const {
+        const auto& head = ownerHeads[list];
+        return head.epoch == orderPool.epoch() ? head.slot : OrderInfo::NO_SLOT;
+    }
+    void trackOwner(Order* order);
+    void untrackOwner(Order* order);
+    void snapshotDepth(Side side, const OrdersAtPrice* best);
+    void publishDepthChanges(Side side, const OrdersAtPrice* best);
+    bool preventSelfTrade(Order* aggressiveOrder, Order* restingOrder, OrdersAtPrice* level);
+    void publishSelfTrade(const Order* order, Qty quantity, bool cancelled);
     void executeMatch(Order* aggressiveOrder, Order* passiveOrder, Qty matchQty, Price matchPrice);
     void processMarketOrder(Order* order);
+    Qty liquidityThrough(Side passiveSide, Price limitPrice, Qty wanted, const PegQuotes& pegs) const;
+    bool canFillCompletely(const Order* order) const;
+    void expireOrder(Order* order, const char* reason);
     bool isBestPrice(const Order* order) const;
 };
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "OrdersAtPrice.h"
 #include "Order.h"
 
-OrdersAtPrice::OrdersAtPrice(Price p) : price(p), firstOrder(nullptr), lastOrder(nullptr), orderCount(0), totalQuantity(0) {}
+OrdersAtPrice::OrdersAtPrice(Price p)
+    : price(p), firstOrder(nullptr), lastOrder(nullptr), orderCount(0), deadOrders(0), totalQuantity(0), hiddenQuantity(0),
+      topOrder(nullptr), prevLevel(nullptr), nextLevel(nullptr) {}
 
 void OrdersAtPrice::appendOrder(Order* order) {
     if (!firstOrder) {
@@ -16,6 +18,25 @@ void OrdersAtPrice::appendOrder(Order* order) {
 }
 
 void OrdersAtPrice::removeOrderFromLevel(Order* order) {
+    unlinkOrder(order);
+    orderCount--;
+    totalQuantity -= order->quantity;
+    if (topOrder == order) {
+        topOrder = nullptr;
+    }
+}
+
+void OrdersAtPrice::buryOrder(Order* order) {
+    orderCount--;
+    deadOrders++;
+    totalQuantity -= order->quantity;
+    order->quantity = 0;
+    if (topOrder == order) {
+        topOrder = nullptr;
+    }
+}
+
+void OrdersAtPrice::unlinkOrder(Order* order) {
     if (order->prevOrder) {
         order->prevOrder->nextOrder = order->nextOrder;
     } else {
@@ -27,7 +48,4 @@ void OrdersAtPrice::removeOrderFromLevel(Order* order) {
     } else {
         lastOrder = order->prevOrder;
     }
-
-    orderCount--;
-    totalQuantity -= order->quantity;
 }
\ No newline at end of file
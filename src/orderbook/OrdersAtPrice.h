@@ -6,13 +6,25 @@ class Order;
 
 class OrdersAtPrice {
 public:
-    explicit OrdersAtPrice(Price p);
+    explicit OrdersAtPrice(Price p = 0);
     void appendOrder(Order* order);
     void removeOrderFromLevel(Order* order);
+    /// Lazy cancel: take the order's quantity out of the totals and leave it queued as a tombstone (quantity 0)
+    /// until unlinkOrder drops it.
+    void buryOrder(Order* order);
+    /// Drop an order from the queue without touching the counts; for tombstones and orders already accounted for.
+    void unlinkOrder(Order* order);
 
     Price price;
     Order* firstOrder;
     Order* lastOrder;
-    size_t orderCount;
-    Qty totalQuantity;
+    size_t orderCount;      // live orders only
+    size_t deadOrders;      // tombstones still linked in the queue
+    Qty totalQuantity;      // displayed quantity
+    Qty hiddenQuantity;     // iceberg reserve behind the displayed quantity
+    Order* topOrder;        // top-order books only: the order that made this price the best, while it stays
+
+    // Neighbouring live levels on the same side, linked best to worst by PriceLadder.
+    OrdersAtPrice* prevLevel;
+    OrdersAtPrice* nextLevel;
 };
\ No newline at end of file
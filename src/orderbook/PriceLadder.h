@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <vector>
+#include "Types.h"
+#include "OrdersAtPrice.h"
+#include "LevelBitmap.h"
+#include "LevelPool.h"
+
+constexpr std::size_t DEFAULT_PRICE_BAND_TICKS = 4096;
+constexpr std::size_t MAX_PRICE_BAND_TICKS = std::size_t{1} << 20;  // widest window a ladder grows to
+
+/// One side of the book stored as a tick-indexed array of price levels.
+/// Slot i holds the level at price basePrice + i, so lookup by price is a subtraction and an index.
+/// Live levels are linked best to worst through OrdersAtPrice::prevLevel/nextLevel, so the best level is read
+/// in O(1) and kept up as levels come and go by relinking neighbours, with no search. The occupancy bitmap over
+/// the slots is what finds a new level's neighbours (and the window's extent when it recenters) without
+/// scanning empty ticks; a slot whose bit is clear is empty whatever pointer it still holds, so slots are
+/// never cleared.
+/// Levels come from a pool owned by the book, so creating or retiring one never touches the allocator.
+/// The window recenters (or widens) when a price falls outside it, but never past MAX_PRICE_BAND_TICKS (or the
+/// initial band, if wider): levels it cannot reach are kept in an ordered overflow map instead, still linked in
+/// priority order with the rest, so memory follows the number of live levels rather than their price range.
+template<Side S>
+class PriceLadder {
+public:
+    static constexpr Side SIDE = S;
+
+    PriceLadder(LevelPool& pool, std::size_t bandTicks = DEFAULT_PRICE_BAND_TICKS)
+        : levelPool(pool), slots(std::max<std::size_t>(bandTicks, 2), nullptr), occupied(slots.size()),
+          basePrice(0), levelCount(0), bestLevel(nullptr) {}
+
+    /// True if price a ranks ahead of price b on this side.
+    static constexpr bool isBetter(Price a, Price b) {
+        if constexpr (S == Side::BUY) {
+            return a > b;
+        } else {
+            return a < b;
+        }
+    }
+
+    OrdersAtPrice* find(Price price) const {
+        const auto index = indexOf(price);
+        if (inWindow(index)) {
+            return occupied.test(index) ? slots[index] : nullptr;
+        }
+        return findOverflow(price);
+    }
+
+    OrdersAtPrice* findOrCreate(Price price) {
+        auto index = indexOf(price);
+        if (!inWindow(index)) [[unlikely]] {
+            if (auto level = findOverflow(price)) {
+                return level;
+            }
+            if (!recenter(price)) {
+                auto level = levelPool.allocate(price);
+                link(level);
+                overflow.emplace(price, level);
+                ++levelCount;
+                return level;
+            }
+            index = indexOf(price);
+        }
+
+        auto& slot = slots[index];
+        if (!occupied.test(index)) {
+            slot = levelPool.allocate(price);
+            link(slot);
+            occupied.set(index);
+            ++levelCount;
+        }
+        return slot;
+    }
+
+    void erase(OrdersAtPrice* level) {
+        unlink(level);
+        detach(level);
+        levelPool.deallocate(level);
+    }
+
+    /// Retire every level ahead of the given one (all levels when nullptr) in one step.
+    /// Used after a sweep; the retired levels must already be empty.
+    void retireBefore(OrdersAtPrice* level) {
+        auto retired = bestLevel;
+        if (retired == level) {
+            return;
+        }
+        bestLevel = level;
+        if (level) {
+            level->prevLevel = nullptr;
+        }
+        while (retired != level) {
+            auto nextLevel = retired->nextLevel;
+            detach(retired);
+            levelPool.deallocate(retired);
+            retired = nextLevel;
+        }
+    }
+
+    OrdersAtPrice* best() const { return bestLevel; }
+
+    /// Quantity an opposite-side order limited at limitPrice (0 for no limit) could take from this side,
+    /// counted only until it reaches wanted. Reads the level totals, never the orders.
+    Qty liquidityThrough(Price limitPrice, Qty wanted) const {
+        Qty available = 0;
+        for (auto level = bestLevel; level && available < wanted; level = level->nextLevel) {
+            if (limitPrice != 0 && isBetter(limitPrice, level->price)) {
+                break;
+            }
+            available += level->totalQuantity + level->hiddenQuantity;
+        }
+        return available;
+    }
+
+    /// Next level behind the given one in priority order, or nullptr.
+    OrdersAtPrice* next(const OrdersAtPrice* level) const { return level->nextLevel; }
+
+    bool empty() const { return levelCount == 0; }
+    std::size_t size() const { return levelCount; }
+    std::size_t bandTicks() const { return slots.size(); }
+
+    /// Drop every level without returning it to the pool, for when the owner releases the whole pool at once.
+    /// Levels in the window are dropped in O(1) by emptying the bitmap; only overflow levels are visited.
+    void forgetAll() {
+        occupied.clearAll();
+        overflow.clear();
+        levelCount = 0;
+        bestLevel = nullptr;
+    }
+
+private:
+    LevelPool& levelPool;
+    std::vector<OrdersAtPrice*> slots;
+    LevelBitmap occupied;
+    std::map<Price, OrdersAtPrice*> overflow;   // live levels outside the window, only once it is at its widest
+    Price basePrice;
+    std::size_t levelCount;
+    OrdersAtPrice* bestLevel;
+
+    std::ptrdiff_t indexOf(Price price) const {
+        return static_cast<std::ptrdiff_t>(price) - basePrice;
+    }
+
+    bool inWindow(std::ptrdiff_t index) const {
+        return index >= 0 && index < static_cast<std::ptrdiff_t>(slots.size());
+    }
+
+    OrdersAtPrice* findOverflow(Price price) const {
+        if (overflow.empty()) [[likely]] {
+            return nullptr;
+        }
+        const auto it = overflow.find(price);
+        return it == overflow.end() ? nullptr : it->second;
+    }
+
+    /// Take a level out of the window or the overflow map; its list links are left to the caller.
+    void detach(OrdersAtPrice* level) {
+        const auto index = indexOf(level->price);
+        if (inWindow(index) && occupied.test(index) && slots[index] == level) {
+            occupied.clear(index);
+        } else {
+            overflow.erase(level->price);
+        }
+        --levelCount;
+    }
+
+    /// Nearest live level ranking ahead of price, from the window's bitmap and the overflow map.
+    OrdersAtPrice* betterNeighbour(Price price) const {
+        const auto index = indexOf(price);
+        std::size_t betterIndex = LevelBitmap::NPOS;
+        if (inWindow(index)) {
+            betterIndex = S == Side::BUY ? occupied.findNextAbove(index) : occupied.findNextBelow(index);
+        } else if ((index < 0) == (S == Side::BUY)) {
+            // Every level in the window ranks ahead of a price beyond its worse end.
+            betterIndex = S == Side::BUY ? occupied.findFirst() : occupied.findLast();
+        }
+        OrdersAtPrice* better = betterIndex == LevelBitmap::NPOS ? nullptr : slots[betterIndex];
+        if (!overflow.empty()) {
+            OrdersAtPrice* outside = nullptr;
+            if constexpr (S == Side::BUY) {
+                if (auto it = overflow.upper_bound(price); it != overflow.end()) {
+                    outside = it->second;
+                }
+            } else {
+                if (auto it = overflow.lower_bound(price); it != overflow.begin()) {
+                    outside = std::prev(it)->second;
+                }
+            }
+            if (outside && (!better || isBetter(better->price, outside->price))) {
+                better = outside;
+            }
+        }
+        return better;
+    }
+
+    /// Splice a new level between its nearest live neighbours, before it is entered in the window or overflow.
+    void link(OrdersAtPrice* level) {
+        OrdersAtPrice* better = betterNeighbour(level->price);
+        OrdersAtPrice* worse = better ? better->nextLevel : bestLevel;
+
+        level->prevLevel = better;
+        level->nextLevel = worse;
+        if (better) {
+            better->nextLevel = level;
+        } else {
+            bestLevel = level;
+        }
+        if (worse) {
+            worse->prevLevel = level;
+        }
+    }
+
+    void unlink(OrdersAtPrice* level) {
+        if (level->prevLevel) {
+            level->prevLevel->nextLevel = level->nextLevel;
+        } else {
+            bestLevel = level->nextLevel;
+        }
+        if (level->nextLevel) {
+            level->nextLevel->prevLevel = level->prevLevel;
+        }
+    }
+
+    /// Move the window so that it covers price and every live level, doubling it if it cannot, up to the
+    /// widest band allowed. Returns false, leaving the window as it is, if even that is too narrow.
+    bool recenter(Price price) {
+        Price low = price;
+        Price high = price;
+        if (!occupied.empty()) {
+            low = std::min(low, slots[occupied.findFirst()]->price);
+            high = std::max(high, slots[occupied.findLast()]->price);
+        }
+        if (!overflow.empty()) {
+            low = std::min(low, overflow.begin()->first);
+            high = std::max(high, overflow.rbegin()->first);
+        }
+
+        auto width = slots.size();
+        const auto maxWidth = std::max(width, MAX_PRICE_BAND_TICKS);
+        const auto span = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(high) - low) + 1;
+        if (span > maxWidth) {
+            return false;
+        }
+        while (width < span * 2 && width < maxWidth) {
+            width = std::min(width * 2, maxWidth);
+        }
+
+        const Price newBase = static_cast<Price>(low - static_cast<std::ptrdiff_t>((width - span) / 2));
+        std::vector<OrdersAtPrice*> moved(width, nullptr);
+        LevelBitmap movedOccupied(width);
+        for (auto level = bestLevel; level; level = level->nextLevel) {
+            const auto index = level->price - newBase;
+            moved[index] = level;
+            movedOccupied.set(index);
+        }
+
+        slots = std::move(moved);
+        occupied = std::move(movedOccupied);
+        overflow.clear();
+        basePrice = newBase;
+        return true;
+    }
+};
@@ -0,0 +1,101 @@
+#include "credit_risk.h"
+#include <cstdlib>
+
+ClientCreditTable clientCredit;
+
+namespace {
+    constexpr int64_t DEFAULT_LIMIT = -1;   // per-client entry that falls back to the default credit limit
+}
+
+CreditMonitor::CreditMonitor(Common::SPSCQueue<FillRecord>* queue)
+    : fillQueue(queue), running(false), creditLimits(ClientCreditTable::MAX_CLIENTS, DEFAULT_LIMIT),
+      netExposure(ClientCreditTable::MAX_CLIENTS, 0), grossExposure(ClientCreditTable::MAX_CLIENTS, 0),
+      openPositions(ClientCreditTable::MAX_CLIENTS, 0), defaultCreditLimit(0) {}
+
+void CreditMonitor::setCreditLimit(ClientId clientId, int64_t limit) {
+    if (clientId < ClientCreditTable::MAX_CLIENTS) {
+        creditLimits[clientId] = limit;
+        publishState(clientId);
+    }
+}
+
+void CreditMonitor::setDefaultCreditLimit(int64_t limit) {
+    defaultCreditLimit = limit;
+    for (ClientId clientId = 0; clientId < ClientCreditTable::MAX_CLIENTS; ++clientId) {
+        if (creditLimits[clientId] == DEFAULT_LIMIT) {
+            publishState(clientId);
+        }
+    }
+}
+
+void CreditMonitor::run() {
+    running = true;
+    FillRecord fill;
+    while (running) {
+        // Spins like the engine: the core is its own, and headroom goes stale for as long as a fill waits here.
+        while (fillQueue->tryPop(fill)) {
+            onRecord(fill);
+        }
+    }
+}
+
+void CreditMonitor::stop() {
+    running = false;
+}
+
+void CreditMonitor::onRecord(const FillRecord& fill) {
+    if (fill.type == MarketData::Type::TRADE) {
+        const bool aggressorBuys = fill.side == 'B';
+        applyFill(fill.aggressiveClientId, fill.tickerId, aggressorBuys, fill.price, fill.quantity);
+        applyFill(fill.passiveClientId, fill.tickerId, !aggressorBuys, fill.price, fill.quantity);
+    } else if (fill.type == MarketData::Type::FLUSH) {
+        flush();
+    }
+}
+
+void CreditMonitor::applyFill(ClientId clientId, TickerId tickerId, bool buy, Price price, Qty quantity) {
+    if (clientId >= ClientCreditTable::MAX_CLIENTS) {
+        return;
+    }
+    const uint64_t key = static_cast<uint64_t>(clientId) << 32 | tickerId;
+    auto [it, inserted] = positionIndex.try_emplace(key, static_cast<uint32_t>(positions.size()));
+    if (inserted) {
+        positions.emplace_back();
+        if (openPositions[clientId]++ == 0) {
+            tradedClients.push_back(clientId);
+        }
+    }
+
+    // Take the position's old mark out of the client's totals and put the new one in.
+    auto& position = positions[it->second];
+    netExposure[clientId] -= position.exposure;
+    grossExposure[clientId] -= std::llabs(position.exposure);
+    position.quantity += buy ? quantity : -quantity;
+    position.exposure = position.quantity * price;
+    netExposure[clientId] += position.exposure;
+    grossExposure[clientId] += std::llabs(position.exposure);
+
+    publishState(clientId);
+}
+
+void CreditMonitor::publishState(ClientId clientId) {
+    const auto limit = creditLimits[clientId] == DEFAULT_LIMIT ? defaultCreditLimit : creditLimits[clientId];
+    clientCredit.publish(clientId, CreditState{
+        netExposure[clientId],
+        grossExposure[clientId],
+        limit > 0 ? limit - grossExposure[clientId] : std::numeric_limits<int64_t>::max()
+    });
+}
+
+/// Ticker ids start again after a flush, so every position is closed and its client reopened with full credit.
+void CreditMonitor::flush() {
+    for (auto clientId : tradedClients) {
+        netExposure[clientId] = 0;
+        grossExposure[clientId] = 0;
+        openPositions[clientId] = 0;
+        publishState(clientId);
+    }
+    tradedClients.clear();
+    positions.clear();
+    positionIndex.clear();
+}
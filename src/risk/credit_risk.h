@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "Types.h"
+#include "seqlock.h"
+#include "robin_hood.h"
+#include "spsc_queue.h"
+#include "market_publisher/market_data.h"
+
+/// A client's executed exposure, in price times quantity (ticks), and what is left of its credit limit.
+struct CreditState {
+    int64_t netExposure = 0;        // long positions count positive, short negative
+    int64_t grossExposure = 0;      // every position counted positive
+    int64_t headroom = std::numeric_limits<int64_t>::max();    // credit limit less gross exposure
+};
+
+/// Per-client credit state published by the credit monitor. The parser thread reads a client's whole state
+/// through its sequence lock; the engine only ever reads the one-byte blocked flag, set once headroom is
+/// used up or while the engine has marked the client's position stale. Client ids from MAX_CLIENTS up are not
+/// tracked and always pass.
+class ClientCreditTable {
+public:
+    static constexpr ClientId MAX_CLIENTS = 1 << 16;
+
+    ClientCreditTable() : states(std::make_unique<Common::SeqLock<CreditState>[]>(MAX_CLIENTS)),
+                          blockedFlags(std::make_unique<std::atomic<uint8_t>[]>(MAX_CLIENTS)) {}
+
+    CreditState state(ClientId clientId) const {
+        return clientId < MAX_CLIENTS ? states[clientId].load() : CreditState{};
+    }
+
+    bool blocked(ClientId clientId) const {
+        return clientId < MAX_CLIENTS && blockedFlags[clientId].load(std::memory_order_relaxed) != 0;
+    }
+
+    /// Writer side: the credit monitor, or the configuring thread before the server starts.
+    void publish(ClientId clientId, const CreditState& state) {
+        states[clientId].store(state);
+        if (state.headroom <= 0) {
+            blockedFlags[clientId].fetch_or(NO_HEADROOM, std::memory_order_relaxed);
+        } else {
+            blockedFlags[clientId].fetch_and(static_cast<uint8_t>(~NO_HEADROOM), std::memory_order_relaxed);
+        }
+    }
+
+    /// Engine side: one of the client's fills never reached the monitor, so its published state cannot be
+    /// trusted. Returns false if the client was already marked or is not tracked.
+    bool markStale(ClientId clientId) {
+        return clientId < MAX_CLIENTS &&
+               (blockedFlags[clientId].fetch_or(STALE, std::memory_order_relaxed) & STALE) == 0;
+    }
+
+    void clearStale(ClientId clientId) {
+        blockedFlags[clientId].fetch_and(static_cast<uint8_t>(~STALE), std::memory_order_relaxed);
+    }
+
+private:
+    // Blocked flag bits, each with a single writer: the monitor owns NO_HEADROOM, the engine STALE.
+    static constexpr uint8_t NO_HEADROOM = 1;
+    static constexpr uint8_t STALE = 2;
+
+    std::unique_ptr<Common::SeqLock<CreditState>[]> states;
+    std::unique_ptr<std::atomic<uint8_t>[]> blockedFlags;
+};
+
+extern ClientCreditTable clientCredit;
+
+/// The engine's end of the credit monitor's queue. It never waits on the monitor: a trade that finds the queue
+/// full is dropped and counted, and both its clients are marked stale, which blocks their new orders until a
+/// flush has closed every position. A flush that finds the queue full is held back and pushed ahead of the
+/// next trade that fits, so the monitor never applies a later trade before it.
+class FillFeed {
+public:
+    FillFeed(Common::SPSCQueue<FillRecord>& queue, ClientCreditTable& credit) : queue(queue), credit(credit) {}
+
+    void trade(const FillRecord& fill) {
+        if ((flushPending && !pushFlush()) || !queue.tryPush(fill)) [[unlikely]] {
+            drop(fill);
+        }
+    }
+
+    void flush() {
+        flushPending = true;
+        staleBeforeFlush = staleClients.size();
+        pushFlush();
+    }
+
+    /// Push a held-back flush, for the engine's idle time.
+    void retry() {
+        if (flushPending) {
+            pushFlush();
+        }
+    }
+
+    /// Trades the monitor never saw since the server started.
+    uint64_t droppedTrades() const { return dropped; }
+
+private:
+    Common::SPSCQueue<FillRecord>& queue;
+    ClientCreditTable& credit;
+    bool flushPending = false;
+    uint64_t dropped = 0;
+    // Clients marked stale, oldest first; the first staleBeforeFlush lost their fills before the pending flush.
+    std::vector<ClientId> staleClients;
+    std::size_t staleBeforeFlush = 0;
+
+    bool pushFlush() {
+        if (!queue.tryPush(FillRecord{MarketData::Type::FLUSH, 0, 0, 0, '-', 0, 0})) {
+            return false;
+        }
+        flushPending = false;
+        // The flush closes the positions the lost fills belonged to; clients that lost one since it was
+        // requested stay stale, and may have been cleared here as well.
+        for (std::size_t i = 0; i < staleBeforeFlush; ++i) {
+            credit.clearStale(staleClients[i]);
+        }
+        staleClients.erase(staleClients.begin(), staleClients.begin() + staleBeforeFlush);
+        staleBeforeFlush = 0;
+        for (auto clientId : staleClients) {
+            credit.markStale(clientId);
+        }
+        return true;
+    }
+
+    void drop(const FillRecord& fill) {
+        ++dropped;
+        // Behind a pending flush a client may be marked already, but must be listed again to stay stale after it.
+        for (auto clientId : {fill.aggressiveClientId, fill.passiveClientId}) {
+            if (credit.markStale(clientId) || (flushPending && clientId < ClientCreditTable::MAX_CLIENTS)) {
+                staleClients.push_back(clientId);
+            }
+        }
+    }
+};
+
+/// Keeps every client's positions from the trade feed and republishes its credit state after each fill.
+/// Runs on its own core, fed by the engine with a FillRecord per trade and flush over a queue of its own, so
+/// headroom never waits on the market data publisher, and neither the parser nor the engine touches a position.
+/// Positions are kept per client and symbol, marked at the client's latest fill in that symbol; a flush closes
+/// them all.
+class CreditMonitor {
+public:
+    explicit CreditMonitor(Common::SPSCQueue<FillRecord>* fillQueue);
+
+    /// Credit limit for one client, or for every client without its own (0 for no limit). Set before the
+    /// server starts.
+    void setCreditLimit(ClientId clientId, int64_t limit);
+    void setDefaultCreditLimit(int64_t limit);
+
+    void run();
+    void stop();
+    /// Apply one TRADE or FLUSH record; run() calls it for each record it dequeues.
+    void onRecord(const FillRecord& fill);
+
+private:
+    struct Position {
+        int64_t quantity = 0;
+        int64_t exposure = 0;   // quantity marked at the last fill price
+    };
+
+    Common::SPSCQueue<FillRecord>* fillQueue;
+    std::atomic<bool> running;
+
+    // Client-indexed arrays; positions are packed in fill order and found through the (client, symbol) map.
+    std::vector<int64_t> creditLimits;
+    std::vector<int64_t> netExposure;
+    std::vector<int64_t> grossExposure;
+    std::vector<uint32_t> openPositions;
+    std::vector<Position> positions;
+    robin_hood::unordered_flat_map<uint64_t, uint32_t> positionIndex;
+    std::vector<ClientId> tradedClients;    // clients with positions, to reopen on a flush
+    int64_t defaultCreditLimit;
+
+    void applyFill(ClientId clientId, TickerId tickerId, bool buy, Price price, Qty quantity);
+    void publishState(ClientId clientId);
+    void flush();
+};
@@ -0,0 +1,164 @@
+#include "pre_trade_risk.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "robin_hood.h"
+#include "credit_risk.h"
+#include "market_publisher/market_data.h"
+
+ReferencePriceTable referencePrices;
+
+namespace {
+    RiskLimits defaultLimits;
+
+    struct SymbolKey {
+        uint64_t words[2] = {0, 0};
+    };
+
+    /// Same truncation as the engine's symbols: at most 15 characters are significant.
+    SymbolKey keyOf(std::string_view symbol) {
+        SymbolKey key;
+        std::memcpy(key.words, symbol.data(), std::min<std::size_t>(symbol.size(), sizeof(key.words) - 1));
+        return key;
+    }
+
+    std::size_t homeSlot(const SymbolKey& key) {
+        return robin_hood::hash_bytes(key.words, sizeof(key.words)) & (ReferencePriceTable::CAPACITY - 1);
+    }
+}
+
+void publishReject(const ParsedMessage& msg, Price price, const char* reason) {
+    MarketData data = {
+        MarketData::Type::REJECT,
+        0,
+        static_cast<ClientId>(msg.userId),
+        static_cast<OrderId>(msg.userOrderId),
+        0, 0,
+        msg.type.front() == 'R' ? '-' : msg.side,
+        price,
+        msg.quantity,
+        reason
+    };
+    marketDataQueue->enqueue(std::move(data));
+}
+
+static_assert((ReferencePriceTable::CAPACITY & (ReferencePriceTable::CAPACITY - 1)) == 0,
+              "capacity must be a power of two");
+
+ReferencePriceTable::Slot* ReferencePriceTable::findOrInsert(std::string_view symbol, const RiskLimits& limits) {
+    if (symbol.empty()) {
+        return nullptr;
+    }
+    const auto key = keyOf(symbol);
+    auto index = homeSlot(key);
+    for (std::size_t probes = 0; probes < CAPACITY; ++probes, index = (index + 1) & (CAPACITY - 1)) {
+        auto& slot = slots[index];
+        const auto first = slot.key[0].load(std::memory_order_relaxed);
+        if (first == 0) {
+            slot.limits = limits;
+            slot.referencePrice.store(0, std::memory_order_relaxed);
+            slot.key[1].store(key.words[1], std::memory_order_relaxed);
+            slot.key[0].store(key.words[0], std::memory_order_release);
+            return &slot;
+        }
+        if (first == key.words[0] && slot.key[1].load(std::memory_order_relaxed) == key.words[1]) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+const ReferencePriceTable::Slot* ReferencePriceTable::find(std::string_view symbol) const {
+    if (symbol.empty()) {
+        return nullptr;
+    }
+    const auto key = keyOf(symbol);
+    auto index = homeSlot(key);
+    for (std::size_t probes = 0; probes < CAPACITY; ++probes, index = (index + 1) & (CAPACITY - 1)) {
+        const auto& slot = slots[index];
+        // A symbol's slot never moves and slots are never emptied, so the first empty slot ends the search.
+        const auto first = slot.key[0].load(std::memory_order_acquire);
+        if (first == 0) {
+            return nullptr;
+        }
+        if (first == key.words[0] && slot.key[1].load(std::memory_order_relaxed) == key.words[1]) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+void ReferencePriceTable::clearPrices() {
+    for (auto& slot : slots) {
+        slot.referencePrice.store(0, std::memory_order_relaxed);
+    }
+}
+
+void setDefaultRiskLimits(const RiskLimits& limits) {
+    defaultLimits = limits;
+}
+
+const RiskLimits& defaultRiskLimits() {
+    return defaultLimits;
+}
+
+void setRiskLimits(const std::string& symbol, const RiskLimits& limits) {
+    if (auto slot = referencePrices.findOrInsert(symbol, limits)) {
+        slot->limits = limits;
+    }
+}
+
+bool passesPreTradeRisk(const ParsedMessage& msg) {
+    const char type = msg.type.front();
+    if (type != 'N' && type != 'S' && type != 'P' && type != 'R') {
+        return true;
+    }
+
+    const RiskLimits* limits = &defaultLimits;
+    Price reference = 0;
+    if (type != 'R') {
+        if (auto slot = referencePrices.find(msg.symbol)) {
+            limits = &slot->limits;
+            reference = slot->referencePrice.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Pegs and market orders have no price of their own; a stop-market order would execute around its trigger.
+    Price price = type == 'P' ? 0 : msg.price;
+    if (type == 'S' && price == 0) {
+        price = msg.triggerPrice;
+    }
+
+    if (limits->maxOrderQuantity > 0 && msg.quantity > limits->maxOrderQuantity) {
+        publishReject(msg, price, "Max quantity");
+        return false;
+    }
+
+    // Stops are meant to sit away from the market; the collar waits until they trigger.
+    if (limits->priceCollarBasisPoints > 0 && reference > 0 && price != 0 && type != 'S') {
+        // |price - reference| / reference > collar, kept in integers.
+        const int64_t distance = std::llabs(static_cast<int64_t>(price) - reference);
+        if (distance * 10000 > static_cast<int64_t>(reference) * limits->priceCollarBasisPoints) {
+            publishReject(msg, price, "Price collar");
+            return false;
+        }
+    }
+
+    // Without a price or a reference the notional is unknown, and only an exhausted credit line stops the order.
+    const int64_t notional = static_cast<int64_t>(price != 0 ? price : reference) * msg.quantity;
+    if (limits->maxNotional > 0 && notional > limits->maxNotional) {
+        publishReject(msg, price, "Max notional");
+        return false;
+    }
+
+    // An amend only reworks an order the client already has, so it is not held against its credit.
+    if (type == 'R') {
+        return true;
+    }
+    const auto headroom = clientCredit.state(static_cast<ClientId>(msg.userId)).headroom;
+    if (notional > headroom || headroom <= 0) {
+        publishReject(msg, price, "Credit limit");
+        return false;
+    }
+    return true;
+}
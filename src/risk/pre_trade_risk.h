@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "Types.h"
+#include "message_parser.h"
+
+/// Pre-trade limits for one symbol; 0 turns a check off.
+struct RiskLimits {
+    uint32_t priceCollarBasisPoints = 0;    // limit prices may lie at most this far from the reference price
+    Qty maxOrderQuantity = 0;
+    int64_t maxNotional = 0;                // price times quantity, in ticks
+};
+
+/// Reference price and limits per symbol, shared by the engine, which publishes each book's reference price
+/// as it changes, and the parser thread, which reads them for every order it checks.
+/// Open addressing over a fixed array; symbols are only ever added, and only by one thread at a time (the
+/// configuring thread before the server starts, then the engine), so readers need no lock: a slot's key is
+/// stored last, with release ordering, and the price is a single atomic word.
+class ReferencePriceTable {
+public:
+    static constexpr std::size_t CAPACITY = 1024;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> key[2] = {0, 0};     // the symbol's first 15 characters, zero padded
+        std::atomic<Price> referencePrice = 0;      // 0 until the book has traded or has a two-sided touch
+        RiskLimits limits;
+    };
+
+    /// Writer side. Returns nullptr for an empty symbol or once the table is full; the symbol is then
+    /// checked against the default limits and has no reference price.
+    Slot* findOrInsert(std::string_view symbol, const RiskLimits& limits);
+    const Slot* find(std::string_view symbol) const;
+    /// Forget every reference price, as after a flush; symbols and their limits stay.
+    void clearPrices();
+
+private:
+    Slot slots[CAPACITY];
+};
+
+extern ReferencePriceTable referencePrices;
+
+/// Limits for symbols without their own setting, and the only ones an amend is checked against: an R message
+/// does not name its symbol. Set before the server starts.
+void setDefaultRiskLimits(const RiskLimits& limits);
+const RiskLimits& defaultRiskLimits();
+/// Limits for one symbol. Set before the server starts.
+void setRiskLimits(const std::string& symbol, const RiskLimits& limits);
+
+/// Check an order-entry message (N, S, P or R) on the parser thread, before it is queued for the engine:
+/// the symbol's limits, then, for new orders, the notional against the client's credit headroom.
+/// A failing message is reported as a REJECT with the limit it broke and must be dropped; the engine never
+/// sees it. Other message types always pass.
+bool passesPreTradeRisk(const ParsedMessage& msg);
+
+/// Report an order-entry message that was refused before reaching a book.
+void publishReject(const ParsedMessage& msg, Price price, const char* reason);
@@ -5,11 +5,17 @@
 #include "matching_engine.h"
 #include "market_publisher/market_publisher.h"
 #include "market_publisher/market_data.h"
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <utility>
+#include <vector>
 #include <chrono>
 #include "utils/OptMemPool.h" 
 #include "logging_util.h"
+#include "credit_risk.h"
+#include "pre_trade_risk.h"
 
 using namespace std::chrono;
 
@@ -19,6 +25,11 @@ extern moodycamel::ConcurrentQueue<std::pair<std::string, system_clock::time_poi
 
 OptCommon::OptMemPool<moodycamel::ConcurrentQueue<MarketData>>* marketDataQueuePool = nullptr;
 moodycamel::ConcurrentQueue<MarketData>* marketDataQueue = nullptr;
+// Engine to credit monitor. Holds about 100 ms of fills at a sustained million a second; if the monitor falls
+// further behind, fills are dropped and their clients blocked rather than the engine stalled (see FillFeed).
+constexpr size_t CREDIT_QUEUE_SIZE = 1 << 17;
+Common::SPSCQueue<FillRecord> creditQueue(CREDIT_QUEUE_SIZE);
+FillFeed creditFeed(creditQueue, clientCredit);
 
 Common::Logger logger("server_log.txt");
 
@@ -62,18 +73,163 @@ void udp_server(const std::string& host, int port) {
     }
 }
 
-int main() {
+/// Splits a KEY=VALUE argument; false when the key or the value is missing.
+bool splitSetting(std::string_view setting, std::string_view& key, std::string_view& value) {
+    const auto separator = setting.find('=');
+    if (separator == std::string_view::npos || separator == 0 || separator + 1 == setting.size()) {
+        return false;
+    }
+    key = setting.substr(0, separator);
+    value = setting.substr(separator + 1);
+    return true;
+}
+
+template<typename Number>
+bool parseNumber(std::string_view text, Number& number) {
+    const char* end = text.data() + text.size();
+    const auto [parsed, error] = std::from_chars(text.data(), end, number);
+    return error == std::errc{} && parsed == end;
+}
+
+bool parseSelfTradePrevention(std::string_view text, SelfTradePrevention& mode) {
+    if (text == "none") { mode = SelfTradePrevention::NONE; return true; }
+    if (text == "cancel-newest") { mode = SelfTradePrevention::CANCEL_NEWEST; return true; }
+    if (text == "cancel-oldest") { mode = SelfTradePrevention::CANCEL_OLDEST; return true; }
+    if (text == "cancel-both") { mode = SelfTradePrevention::CANCEL_BOTH; return true; }
+    if (text == "decrement") { mode = SelfTradePrevention::DECREMENT; return true; }
+    return false;
+}
+
+/// COLLAR_BP,MAX_QTY,MAX_NOTIONAL, as in RiskLimits; 0 turns a check off.
+bool parseRiskLimits(std::string_view text, RiskLimits& limits) {
+    const auto first = text.find(',');
+    const auto second = first == std::string_view::npos ? first : text.find(',', first + 1);
+    return second != std::string_view::npos &&
+           parseNumber(text.substr(0, first), limits.priceCollarBasisPoints) &&
+           parseNumber(text.substr(first + 1, second - first - 1), limits.maxOrderQuantity) &&
+           parseNumber(text.substr(second + 1), limits.maxNotional);
+}
+
+bool parseMatchingPolicy(std::string_view text, MatchingPolicy& policy) {
+    if (text == "fifo") { policy = MatchingPolicy::FIFO; return true; }
+    if (text == "pro-rata") { policy = MatchingPolicy::PRO_RATA; return true; }
+    if (text == "top-order-pro-rata") { policy = MatchingPolicy::TOP_ORDER_PRO_RATA; return true; }
+    return false;
+}
+
+/// Credit limits from the command line, held until the credit monitor exists; 0 is no limit.
+struct CreditSettings {
+    int64_t defaultLimit = 0;
+    std::vector<std::pair<ClientId, int64_t>> limits;
+};
+
+/// Command line: --feed classic|l3 picks the market data feed (classic by default). The per-symbol settings
+/// may be repeated, once per symbol: --depth SYMBOL=LEVELS turns on the L2 depth feed, and
+/// --stp SYMBOL=none|cancel-newest|cancel-oldest|cancel-both|decrement sets self-trade prevention and
+/// --policy SYMBOL=fifo|pro-rata|top-order-pro-rata the matching policy, and --lazy-cancels SYMBOL turns on
+/// tombstone cancels. Pre-trade limits are given as
+/// COLLAR_BP,MAX_QTY,MAX_NOTIONAL: --risk SYMBOL=LIMITS for one symbol, --default-risk LIMITS for the others
+/// and for every amend. --credit-limit CLIENT=LIMIT sets one client's credit limit and --default-credit-limit
+/// LIMIT everyone else's.
+bool parseArguments(int argc, char* argv[], MarketPublisher::FeedMode& feedMode, CreditSettings& credit) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        std::string_view key, value;
+        if (arg == "--depth" && i + 1 < argc && splitSetting(argv[++i], key, value)) {
+            std::size_t levels = 0;
+            if (parseNumber(value, levels)) {
+                setDepthLevels(std::string(key), levels);
+                continue;
+            }
+        }
+        if (arg == "--stp" && i + 1 < argc && splitSetting(argv[++i], key, value)) {
+            SelfTradePrevention mode;
+            if (parseSelfTradePrevention(value, mode)) {
+                setSelfTradePrevention(std::string(key), mode);
+                continue;
+            }
+        }
+        if (arg == "--policy" && i + 1 < argc && splitSetting(argv[++i], key, value)) {
+            MatchingPolicy policy;
+            if (parseMatchingPolicy(value, policy)) {
+                setMatchingPolicy(std::string(key), policy);
+                continue;
+            }
+        }
+        if (arg == "--lazy-cancels" && i + 1 < argc) {
+            setLazyCancels(argv[++i], true);
+            continue;
+        }
+        if (arg == "--risk" && i + 1 < argc && splitSetting(argv[++i], key, value)) {
+            RiskLimits limits;
+            if (parseRiskLimits(value, limits)) {
+                setRiskLimits(std::string(key), limits);
+                continue;
+            }
+        }
+        if (arg == "--default-risk" && i + 1 < argc) {
+            RiskLimits limits;
+            if (parseRiskLimits(argv[++i], limits)) {
+                setDefaultRiskLimits(limits);
+                continue;
+            }
+        }
+        if (arg == "--credit-limit" && i + 1 < argc && splitSetting(argv[++i], key, value)) {
+            ClientId clientId = 0;
+            int64_t limit = 0;
+            if (parseNumber(key, clientId) && parseNumber(value, limit)) {
+                credit.limits.emplace_back(clientId, limit);
+                continue;
+            }
+        }
+        if (arg == "--default-credit-limit" && i + 1 < argc && parseNumber(argv[++i], credit.defaultLimit)) {
+            continue;
+        }
+        if (arg == "--feed" && i + 1 < argc) {
+            const std::string_view mode = argv[++i];
+            if (mode == "classic") {
+                feedMode = MarketPublisher::FeedMode::CLASSIC;
+                continue;
+            }
+            if (mode == "l3") {
+                feedMode = MarketPublisher::FeedMode::L3;
+                continue;
+            }
+        }
+        LOG(error) << "Bad argument " << argv[i] << "; usage: server [--feed classic|l3] [--depth SYMBOL=LEVELS]..."
+                   << " [--stp SYMBOL=none|cancel-newest|cancel-oldest|cancel-both|decrement]..."
+                   << " [--policy SYMBOL=fifo|pro-rata|top-order-pro-rata]... [--lazy-cancels SYMBOL]..."
+                   << " [--risk SYMBOL=COLLAR_BP,MAX_QTY,MAX_NOTIONAL]... [--default-risk COLLAR_BP,MAX_QTY,MAX_NOTIONAL]"
+                   << " [--credit-limit CLIENT=LIMIT]... [--default-credit-limit LIMIT]";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
     initializeLogging();
+
+    auto feedMode = MarketPublisher::FeedMode::CLASSIC;
+    CreditSettings credit;
+    if (!parseArguments(argc, argv, feedMode, credit)) {
+        return 1;
+    }
     initializeGlobalData();
 
-    MarketPublisher marketPublisher(marketDataQueue);
-    initializeMatchingEngine(marketDataQueue);
+    MarketPublisher marketPublisher(marketDataQueue, feedMode);
+    CreditMonitor creditMonitor(&creditQueue);
+    creditMonitor.setDefaultCreditLimit(credit.defaultLimit);
+    for (const auto& [clientId, limit] : credit.limits) {
+        creditMonitor.setCreditLimit(clientId, limit);
+    }
+    initializeMatchingEngine(marketDataQueue, &creditFeed);
 
     // Define core IDs for each component
     int server_core_id = 0;
     int parser_core_id = 1;
     int engine_core_id = 2;
     int publisher_core_id = 3;
+    int credit_core_id = 4;
 
     // Create and start threads with core affinity
     auto server_thread = Common::createAndStartThread(server_core_id, "UDPServer", 
@@ -88,16 +244,21 @@ int main() {
     auto publisher_thread = Common::createAndStartThread(publisher_core_id, "MarketPublisher", 
         [&marketPublisher]() { marketPublisher.run(); });
 
+    auto credit_thread = Common::createAndStartThread(credit_core_id, "CreditMonitor",
+        [&creditMonitor]() { creditMonitor.run(); });
+
     server_thread->join();
     parser_thread->join();
     engine_thread->join();
     publisher_thread->join();
+    credit_thread->join();
 
     // Clean up resources
     delete server_thread;
     delete parser_thread;
     delete engine_thread;
     delete publisher_thread;
+    delete credit_thread;
 
     cleanupGlobalData();
     delete server_socket;
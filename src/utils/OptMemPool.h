@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -11,20 +12,19 @@ namespace OptCommon {
   class OptMemPool final {
   public:
     explicit OptMemPool(std::size_t num_elems) :
-        store_(num_elems) /* pre-allocation of vector storage. */ {
-      ASSERT(reinterpret_cast<const ObjectBlock *>(&(store_[0].object_)) == &(store_[0]), "T object should be first member of ObjectBlock.");
+        store_(num_elems), /* pre-allocation of vector storage. */
+        in_use_epoch_(num_elems, FREE) {
     }
 
     /// Allocate a new object of type T, use placement new to initialize the object, mark the block as in-use and return the object.
     template<typename... Args>
     T *allocate(Args... args) noexcept {
-      auto obj_block = &(store_[next_free_index_]);
 #if !defined(NDEBUG)
-      ASSERT(obj_block->is_free_, "Expected free ObjectBlock at index:" + std::to_string(next_free_index_));
+      ASSERT(isFree(next_free_index_), "Expected free block at index:" + std::to_string(next_free_index_));
 #endif
-      T *ret = &(obj_block->object_);
+      T *ret = &(store_[next_free_index_]);
       new(ret) T(args...); // placement new.
-      obj_block->is_free_ = false;
+      in_use_epoch_[next_free_index_] = epoch_;
 
       updateNextFreeIndex();
 
@@ -34,12 +34,45 @@ namespace OptCommon {
     /// Return the object back to the pool by marking the block as free again.
     /// Destructor is not called for the object.
     auto deallocate(const T *elem) noexcept {
-      const auto elem_index = (reinterpret_cast<const ObjectBlock *>(elem) - &store_[0]);
+      const auto elem_index = indexOf(elem);
 #if !defined(NDEBUG)
-      ASSERT(elem_index >= 0 && static_cast<size_t>(elem_index) < store_.size(), "Element being deallocated does not belong to this Memory pool.");
-      ASSERT(!store_[elem_index].is_free_, "Expected in-use ObjectBlock at index:" + std::to_string(elem_index));
+      ASSERT(elem_index < store_.size(), "Element being deallocated does not belong to this Memory pool.");
+      ASSERT(!isFree(elem_index), "Expected in-use block at index:" + std::to_string(elem_index));
 #endif
-      store_[elem_index].is_free_ = true;
+      in_use_epoch_[elem_index] = FREE;
+    }
+
+    /// Return every block to the pool at once, in O(1): blocks allocated before the call are treated as free
+    /// from then on, without being visited. Pointers into the pool must not be used afterwards.
+    auto releaseAll() noexcept {
+      if (UNLIKELY(++epoch_ == FREE)) { // after 2^32 - 1 releases the marks are cleared once and counting restarts.
+        std::fill(in_use_epoch_.begin(), in_use_epoch_.end(), FREE);
+        epoch_ = 1;
+      }
+      next_free_index_ = 0;
+    }
+
+    /// Slot index of an element of this pool, stable for the element's lifetime.
+    /// Lets callers keep parallel per-slot arrays next to the pool.
+    std::size_t indexOf(const T *elem) const noexcept {
+      return static_cast<std::size_t>(elem - store_.data());
+    }
+
+    T *at(std::size_t index) noexcept {
+      return &store_[index];
+    }
+
+    const T *at(std::size_t index) const noexcept {
+      return &store_[index];
+    }
+
+    std::size_t capacity() const noexcept {
+      return store_.size();
+    }
+
+    /// Changes with every releaseAll(), so per-slot data kept beside the pool can tell which release it dates from.
+    uint32_t epoch() const noexcept {
+      return epoch_;
     }
 
     // Deleted default, copy & move constructors and assignment-operators.
@@ -57,7 +90,7 @@ namespace OptCommon {
     /// Find the next available free block to be used for the next allocation.
     auto updateNextFreeIndex() noexcept {
       const auto initial_free_index = next_free_index_;
-      while (!store_[next_free_index_].is_free_) {
+      while (!isFree(next_free_index_)) {
         ++next_free_index_;
         if (UNLIKELY(next_free_index_ == store_.size())) { // hardware branch predictor should almost always predict this to be false any ways.
           next_free_index_ = 0;
@@ -70,12 +103,17 @@ namespace OptCommon {
       }
     }
 
-    struct ObjectBlock {
-      T object_;
-      bool is_free_ = true;
-    };
+    bool isFree(std::size_t index) const noexcept {
+      return in_use_epoch_[index] != epoch_;
+    }
+
+    static constexpr uint32_t FREE = 0;
 
-    std::vector<ObjectBlock> store_;
+    // Free marks live beside the objects rather than inside each block, so T keeps its own size and alignment.
+    // A block is in use only while its mark equals the current epoch, so releaseAll() frees every block at once.
+    std::vector<T> store_;
+    std::vector<uint32_t> in_use_epoch_;
+    uint32_t epoch_ = 1;
 
     size_t next_free_index_ = 0;
   };
@@ -11,4 +11,42 @@ using Qty = int32_t;
 enum class Side : uint8_t {
     BUY,
     SELL
-};
\ No newline at end of file
+};
+
+/// DAY rests any unfilled remainder, IOC cancels it, FOK trades only if the whole quantity fills at once.
+enum class TimeInForce : uint8_t {
+    DAY,
+    IOC,
+    FOK
+};
+
+/// Reference a pegged order tracks: PRIMARY joins its own side's best price, MARKET sits one tick inside the
+/// opposite best price, MIDPOINT sits at the middle of the spread (rounded away from crossing it).
+enum class PegType : uint8_t {
+    NONE,
+    PRIMARY,
+    MARKET,
+    MIDPOINT
+};
+
+
+/// What the book does when an order would trade against a resting order of the same client.
+/// DECREMENT takes the smaller open quantity off both orders without a trade.
+enum class SelfTradePrevention : uint8_t {
+    NONE,
+    CANCEL_NEWEST,
+    CANCEL_OLDEST,
+    CANCEL_BOTH,
+    DECREMENT
+};
+
+
+/// How an incoming order's quantity is shared among the resting orders of a price level.
+/// FIFO fills them in time priority. PRO_RATA splits it in proportion to their sizes, with the rounding
+/// remainder going to the front of the queue. TOP_ORDER_PRO_RATA first fills the order that set the level as
+/// the best price, then splits the rest pro rata.
+enum class MatchingPolicy : uint8_t {
+    FIFO,
+    PRO_RATA,
+    TOP_ORDER_PRO_RATA
+};
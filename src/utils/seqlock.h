@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace Common {
+  /// Single-writer sequence lock around a small trivially copyable value.
+  /// The writer never waits: it makes the sequence odd, stores the value and makes it even again. Readers
+  /// copy the value and retry if the sequence was odd or moved while they read, so they never block the
+  /// writer and never see a torn value. The value is kept in atomic words, so the racing copy is well defined.
+  template<typename T>
+  class SeqLock final {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock holds trivially copyable values only");
+
+  public:
+    SeqLock() noexcept {
+      store(T{});
+    }
+
+    /// Writer side; one thread only.
+    auto store(const T &value) noexcept {
+      uint64_t words[WORDS] = {};
+      std::memcpy(words, &value, sizeof(T));
+      const auto sequence = sequence_.load(std::memory_order_relaxed);
+      sequence_.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (std::size_t i = 0; i < WORDS; ++i) {
+        words_[i].store(words[i], std::memory_order_relaxed);
+      }
+      sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    auto load() const noexcept {
+      uint64_t words[WORDS];
+      uint64_t before;
+      uint64_t after;
+      do {
+        before = sequence_.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < WORDS; ++i) {
+          words[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence_.load(std::memory_order_relaxed);
+      } while ((before & 1) != 0 || before != after);
+
+      T value;
+      std::memcpy(&value, words, sizeof(T));
+      return value;
+    }
+
+  private:
+    static constexpr std::size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> sequence_ = {0};
+    std::atomic<uint64_t> words_[WORDS] = {};
+  };
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+#include "macros.h"
+
+namespace Common {
+  /// Bounded single-producer, single-consumer ring of trivially copyable values.
+  /// Unlike LFQueue it refuses a push when full instead of overwriting unread entries, and the two indices
+  /// sit on their own cache lines, so producer and consumer only share a line when the ring is nearly empty.
+  template<typename T>
+  class SPSCQueue final {
+    static_assert(std::is_trivially_copyable_v<T>, "SPSCQueue holds trivially copyable values only");
+
+  public:
+    /// capacity is rounded up to a power of two.
+    explicit SPSCQueue(std::size_t capacity) :
+        mask_(roundUp(capacity) - 1), store_(std::make_unique<T[]>(mask_ + 1)) {
+    }
+
+    /// Producer side. Returns false, leaving the queue unchanged, when it is full.
+    bool tryPush(const T &value) noexcept {
+      const auto tail = tail_.load(std::memory_order_relaxed);
+      if (UNLIKELY(tail - head_.load(std::memory_order_acquire) > mask_)) {
+        return false;
+      }
+      store_[tail & mask_] = value;
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /// Consumer side. Returns false when the queue is empty.
+    bool tryPop(T &value) noexcept {
+      const auto head = head_.load(std::memory_order_relaxed);
+      if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+      }
+      value = store_[head & mask_];
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Deleted copy & move constructors and assignment-operators.
+    SPSCQueue(const SPSCQueue &) = delete;
+
+    SPSCQueue(const SPSCQueue &&) = delete;
+
+    SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+    SPSCQueue &operator=(const SPSCQueue &&) = delete;
+
+  private:
+    static std::size_t roundUp(std::size_t capacity) noexcept {
+      std::size_t size = 1;
+      while (size < capacity) {
+        size <<= 1;
+      }
+      return size;
+    }
+
+    const std::size_t mask_;
+    std::unique_ptr<T[]> store_;
+
+    alignas(64) std::atomic<std::size_t> head_ = {0};   // next slot to read; written by the consumer
+    alignas(64) std::atomic<std::size_t> tail_ = {0};   // next slot to write; written by the producer
+  };
+}
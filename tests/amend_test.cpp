@@ -0,0 +1,104 @@
+#include <map>
+#include <string>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// An amend that only reduces the open quantity at the same price is applied in place and keeps the order's
+// place in the queue; a size-up or a price change re-inserts it behind the level and may trade.
+
+namespace {
+  using TestHarness::expect;
+
+  constexpr ClientId FIRST = 1;
+  constexpr ClientId SECOND = 2;
+  constexpr ClientId BUYER = 9;
+
+  /// FIRST then SECOND each offer 10 at 100.
+  struct Book {
+    moodycamel::ConcurrentQueue<MarketData> queue{256};
+    OrderBook book{1, &queue, 64};
+    OrderHandle first;
+    OrderId nextClientOrderId = 3;
+
+    Book() {
+      first = book.addOrder(FIRST, 1, Side::SELL, 100, 10);
+      book.addOrder(SECOND, 2, Side::SELL, 100, 10);
+    }
+
+    /// Quantity each resting client sold to a buy of quantity at price.
+    std::map<ClientId, Qty> buy(Price price, Qty quantity) {
+      TestHarness::drain(queue);
+      book.addOrder(BUYER, nextClientOrderId++, Side::BUY, price, quantity);
+      std::map<ClientId, Qty> sold;
+      for (const auto& data : TestHarness::drain(queue)) {
+        if (data.type == MarketData::Type::TRADE) {
+          sold[data.passiveClientId] += data.quantity;
+        }
+      }
+      return sold;
+    }
+  };
+
+  void sizeDownKeepsPriority() {
+    Book fixture;
+    TestHarness::drain(fixture.queue);
+    const auto handle = fixture.book.modifyOrder(FIRST, 1, fixture.first, 100, 4);
+    const auto published = TestHarness::drain(fixture.queue);
+    expect(handle.slot == fixture.first.slot && fixture.book.holds(handle), "an in-place amend keeps the handle");
+    expect(!published.empty() && published.front().type == MarketData::Type::MODIFY &&
+           published.front().quantity == 4 && published.front().message.empty(), "the amend is published with the new size");
+
+    const auto sold = fixture.buy(100, 10);
+    expect(sold.at(FIRST) == 4 && sold.at(SECOND) == 6, "after a size-down the order still trades first");
+  }
+
+  void sizeUpLosesPriority() {
+    Book fixture;
+    fixture.book.modifyOrder(FIRST, 1, fixture.first, 100, 15);
+    const auto sold = fixture.buy(100, 10);
+    expect(sold.size() == 1 && sold.at(SECOND) == 10, "after a size-up the order queues behind the level");
+  }
+
+  void priceChangeLosesPriority() {
+    Book fixture;
+    fixture.book.modifyOrder(FIRST, 1, fixture.first, 101, 10);
+    fixture.book.modifyOrder(FIRST, 1, fixture.first, 100, 10);
+    const auto sold = fixture.buy(100, 10);
+    expect(sold.size() == 1 && sold.at(SECOND) == 10, "an order moved away and back queues behind the level");
+  }
+
+  void crossingAmendTrades() {
+    Book fixture;
+    fixture.book.addOrder(BUYER, 3, Side::BUY, 99, 10);
+    TestHarness::drain(fixture.queue);
+    fixture.book.modifyOrder(FIRST, 1, fixture.first, 99, 10);
+    Qty traded = 0;
+    for (const auto& data : TestHarness::drain(fixture.queue)) {
+      if (data.type == MarketData::Type::TRADE) {
+        traded += data.quantity;
+        expect(data.aggressiveClientId == FIRST && data.price == 99, "the amended order is the aggressor at 99");
+      }
+    }
+    expect(traded == 10, "an amend across the spread trades");
+    expect(!fixture.book.holds(fixture.first), "the filled order leaves the book");
+  }
+
+  void othersCannotAmend() {
+    Book fixture;
+    TestHarness::drain(fixture.queue);
+    fixture.book.modifyOrder(SECOND, 1, fixture.first, 100, 4);
+    const auto published = TestHarness::drain(fixture.queue);
+    expect(published.size() == 1 && published.front().message == "Rejected", "another client's amend is rejected");
+    const auto sold = fixture.buy(100, 10);
+    expect(sold.size() == 1 && sold.at(FIRST) == 10, "and the order is untouched");
+  }
+}
+
+int main() {
+  sizeDownKeepsPriority();
+  sizeUpLosesPriority();
+  priceChangeLosesPriority();
+  crossingAmendTrades();
+  othersCannotAmend();
+  return TestHarness::finish();
+}
@@ -0,0 +1,177 @@
+#include <limits>
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// An uncross trades everything that crosses at the equilibrium price, with self-trade prevention applied to
+// each pair of orders it brings together, exactly as in continuous matching.
+
+namespace {
+  using TestHarness::expect;
+  using TestHarness::drain;
+
+  struct Entry {
+    ClientId clientId;
+    Side side;
+    Price price;
+    Qty quantity;
+  };
+
+  struct Outcome {
+    int64_t traded = 0;
+    std::size_t selfTradeCancels = 0;
+    Price uncrossPrice = 0;
+    Qty uncrossVolume = 0;
+  };
+
+  /// Collect the orders in a call auction, in the order given, then uncross it.
+  template<std::size_t N>
+  Outcome uncross(SelfTradePrevention mode, const Entry (&orders)[N], OrderBook* keep = nullptr) {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook local(1, &queue, 64);
+    OrderBook& book = keep ? *keep : local;
+    book.setSelfTradePrevention(mode);
+    book.openAuction();
+    OrderId nextClientOrderId = 1;
+    for (const auto& order : orders) {
+      book.addOrder(order.clientId, nextClientOrderId++, order.side, order.price, order.quantity);
+    }
+    drain(queue);
+
+    book.uncrossAuction();
+    Outcome outcome;
+    for (const auto& data : drain(queue)) {
+      if (data.type == MarketData::Type::TRADE) {
+        outcome.traded += data.quantity;
+      } else if (data.type == MarketData::Type::CANCEL && data.message == "Self-trade") {
+        ++outcome.selfTradeCancels;
+      } else if (data.type == MarketData::Type::AUCTION && data.message == "Uncross") {
+        outcome.uncrossPrice = data.price;
+        outcome.uncrossVolume = data.quantity;
+      }
+    }
+    return outcome;
+  }
+
+  void ownOrdersDoNotTradeInTheUncross() {
+    const Entry ownPair[] = {{1, Side::BUY, 100, 10}, {1, Side::SELL, 100, 10}};
+    const auto unprevented = uncross(SelfTradePrevention::NONE, ownPair);
+    expect(unprevented.traded == 10, "without prevention a client's own buy and sell uncross");
+
+    for (auto mode : {SelfTradePrevention::CANCEL_NEWEST, SelfTradePrevention::CANCEL_OLDEST,
+                      SelfTradePrevention::CANCEL_BOTH, SelfTradePrevention::DECREMENT}) {
+      const auto outcome = uncross(mode, ownPair);
+      expect(outcome.traded == 0, "prevention stops a client's own buy and sell uncrossing");
+    }
+    const auto both = uncross(SelfTradePrevention::CANCEL_BOTH, ownPair);
+    expect(both.selfTradeCancels == 2, "CANCEL_BOTH cancels both of the client's orders");
+  }
+
+  void uncrossTradesOnPastPreventedOrders() {
+    // Client 1's sell is first at 100 and newer than its buy, so CANCEL_NEWEST cancels it and the buy meets client 2.
+    const Entry orders[] = {{1, Side::BUY, 101, 10}, {1, Side::SELL, 100, 10}, {2, Side::SELL, 100, 10}};
+    const auto outcome = uncross(SelfTradePrevention::CANCEL_NEWEST, orders);
+    expect(outcome.selfTradeCancels == 1, "the newer own order is cancelled");
+    expect(outcome.traded == 10, "the older own order still trades with another client");
+
+    // Here the buy is the newer own order: once it is cancelled nothing crosses, and both sells are left resting.
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    const Entry crossed[] = {{1, Side::SELL, 100, 10}, {1, Side::BUY, 101, 10}, {2, Side::SELL, 100, 10}};
+    uncross(SelfTradePrevention::CANCEL_NEWEST, crossed, &book);
+    drain(queue);
+    book.addOrder(3, 99, Side::BUY, 100, 10);
+    Qty traded = 0;
+    for (const auto& data : drain(queue)) {
+      traded += data.type == MarketData::Type::TRADE ? data.quantity : 0;
+    }
+    expect(traded == 10, "the sell that never met a buyer in the uncross still rests at 100");
+  }
+
+  void icebergSelfTradeCancelsItsReserve() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.setSelfTradePrevention(SelfTradePrevention::CANCEL_NEWEST);
+    book.openAuction();
+    book.addOrder(1, 1, Side::SELL, 100, 10);
+    book.addOrder(1, 2, Side::BUY, 100, 30, TimeInForce::DAY, 5);
+    book.uncrossAuction();
+    Qty cancelled = 0;
+    for (const auto& data : drain(queue)) {
+      cancelled += data.type == MarketData::Type::CANCEL && data.message == "Self-trade" ? data.quantity : 0;
+    }
+    expect(cancelled == 30, "a cancelled iceberg is reported with its reserve");
+    book.addOrder(2, 1, Side::SELL, 100, 10);
+    Qty traded = 0;
+    for (const auto& data : drain(queue)) {
+      traded += data.type == MarketData::Type::TRADE ? data.quantity : 0;
+    }
+    expect(traded == 0, "no slice of the cancelled iceberg is left to trade");
+  }
+
+  void volumesBeyondAQtyPickTheRightPrice() {
+    // Cumulative bids and asks both reach 3e9 at 100, past what a Qty holds; that is the price trading the most.
+    const Entry large[] = {{1, Side::BUY, 101, 1'500'000'000}, {2, Side::BUY, 100, 1'500'000'000},
+                           {3, Side::SELL, 99, 2'000'000'000}, {4, Side::SELL, 100, 1'000'000'000}};
+    const auto outcome = uncross(SelfTradePrevention::NONE, large);
+    expect(outcome.uncrossPrice == 100, "the equilibrium is found past a Qty's range");
+    expect(outcome.traded == 3'000'000'000, "the whole executable volume trades");
+    expect(outcome.uncrossVolume == std::numeric_limits<Qty>::max(), "the published volume is capped, not wrapped");
+  }
+
+  /// The last indicative published, or nothing if none was.
+  struct Indicative {
+    bool published = false;
+    Price price = 0;
+    Qty volume = 0;
+  };
+
+  Indicative lastIndicative(moodycamel::ConcurrentQueue<MarketData>& queue) {
+    Indicative indicative;
+    for (const auto& data : drain(queue)) {
+      if (data.type == MarketData::Type::AUCTION && data.message == "Indicative") {
+        indicative = {true, data.price, data.quantity};
+      }
+    }
+    return indicative;
+  }
+
+  void indicativeFollowsCrossingLevels() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.openAuction();
+    const auto bid = book.addOrder(1, 1, Side::BUY, 101, 10);
+    book.addOrder(2, 1, Side::SELL, 100, 6);
+    auto indicative = lastIndicative(queue);
+    expect(indicative.published && indicative.price == 101 && indicative.volume == 6,
+           "a cross publishes an indicative, at the higher price under buy pressure");
+
+    book.addOrder(2, 2, Side::SELL, 105, 50);
+    book.addOrder(1, 2, Side::BUY, 90, 50);
+    expect(!lastIndicative(queue).published, "orders outside the crossed range leave the indicative alone");
+
+    book.addOrder(2, 3, Side::SELL, 101, 10);
+    indicative = lastIndicative(queue);
+    expect(indicative.published && indicative.price == 101 && indicative.volume == 10,
+           "a new ask inside the range moves it");
+
+    book.modifyOrder(1, 1, bid, 101, 4);
+    indicative = lastIndicative(queue);
+    expect(indicative.published && indicative.volume == 4, "an in-place size down of a crossing bid moves it");
+
+    book.cancelOrder(1, 1, bid);
+    indicative = lastIndicative(queue);
+    expect(indicative.published && indicative.volume == 0, "cancelling the only crossing bid clears it");
+  }
+}
+
+int main() {
+  ownOrdersDoNotTradeInTheUncross();
+  uncrossTradesOnPastPreventedOrders();
+  icebergSelfTradeCancelsItsReserve();
+  volumesBeyondAQtyPickTheRightPrice();
+  indicativeFollowsCrossingLevels();
+
+  return TestHarness::finish();
+}
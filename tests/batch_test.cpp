@@ -0,0 +1,103 @@
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// A batch publishes every order event as it happens but the top of book only once per side, after the last
+// command, and only for a side whose best price or size moved.
+
+namespace {
+  using TestHarness::expect;
+
+  BookCommand add(ClientId clientId, OrderId clientOrderId, Side side, Price price, Qty quantity,
+                  TimeInForce timeInForce = TimeInForce::DAY) {
+    BookCommand command;
+    command.clientId = clientId;
+    command.clientOrderId = clientOrderId;
+    command.side = side;
+    command.price = price;
+    command.quantity = quantity;
+    command.timeInForce = timeInForce;
+    return command;
+  }
+
+  std::vector<MarketData> ofType(const std::vector<MarketData>& records, MarketData::Type type) {
+    std::vector<MarketData> matching;
+    for (const auto& data : records) {
+      if (data.type == type) {
+        matching.push_back(data);
+      }
+    }
+    return matching;
+  }
+
+  void oneUpdatePerSide() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    BookCommand commands[] = {
+      add(1, 1, Side::BUY, 100, 10),
+      add(1, 2, Side::BUY, 101, 5),
+      add(2, 3, Side::SELL, 103, 3),
+      add(2, 4, Side::SELL, 102, 7),
+    };
+    book.applyBatch(commands);
+    const auto published = TestHarness::drain(queue);
+    const auto updates = ofType(published, MarketData::Type::BOOK_UPDATE);
+
+    expect(ofType(published, MarketData::Type::ADD).size() == 4, "every add in the batch is published");
+    expect(updates.size() == 2, "the batch publishes one top-of-book update per side");
+    for (const auto& update : updates) {
+      expect(update.side == 'B' ? update.price == 101 && update.quantity == 5 : update.price == 102 && update.quantity == 7,
+             std::string("the ") + update.side + " update shows the side as the batch left it");
+    }
+    for (const auto& command : commands) {
+      expect(book.holds(command.handle), "each resting order's handle is returned in its command");
+    }
+  }
+
+  void unchangedTopIsNotRepublished() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(1, 1, Side::BUY, 100, 10);
+    book.addOrder(2, 2, Side::SELL, 102, 10);
+    TestHarness::drain(queue);
+
+    // An IOC with nothing to trade and an add behind the touch leave both best levels as they were.
+    BookCommand commands[] = {
+      add(1, 3, Side::BUY, 101, 5, TimeInForce::IOC),
+      add(2, 4, Side::SELL, 103, 5),
+    };
+    book.applyBatch(commands);
+    const auto published = TestHarness::drain(queue);
+    expect(ofType(published, MarketData::Type::BOOK_UPDATE).empty(), "a batch that leaves the touch alone publishes no update");
+    expect(!commands[0].handle.valid(), "the IOC does not rest");
+  }
+
+  void tradesInsideABatch() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(2, 1, Side::SELL, 100, 5);
+    book.addOrder(2, 2, Side::SELL, 101, 5);
+    TestHarness::drain(queue);
+
+    // The first buy takes the whole 100 level, the second part of 101.
+    BookCommand commands[] = {
+      add(1, 3, Side::BUY, 100, 5),
+      add(1, 4, Side::BUY, 101, 2),
+    };
+    book.applyBatch(commands);
+    const auto published = TestHarness::drain(queue);
+    const auto updates = ofType(published, MarketData::Type::BOOK_UPDATE);
+    expect(ofType(published, MarketData::Type::TRADE).size() == 2, "both trades are published");
+    expect(updates.size() == 1 && updates.front().side == 'S' && updates.front().price == 101 &&
+           updates.front().quantity == 3, "the offer is published once, as 3 at 101");
+    expect(!commands[0].handle.valid() && !commands[1].handle.valid(), "filled orders return no handle");
+  }
+}
+
+int main() {
+  oneUpdatePerSide();
+  unchangedTopIsNotRepublished();
+  tradesInsideABatch();
+  return TestHarness::finish();
+}
@@ -0,0 +1,133 @@
+#include <string>
+#include <unordered_set>
+#include "client_order_index.h"
+#include "test_harness.h"
+
+// The client order index finds every entry it holds wherever it lives: ids below a client's first one, orders
+// still live when the dense window slides past them, and entries erased after a slide. Slides and sweeps drop
+// the entries of filled orders and keep the live ones.
+
+namespace {
+  using TestHarness::expect;
+
+  constexpr auto WINDOW = ClientOrderIndex::DENSE_WINDOW;
+
+  /// Each test order's handle slot is its client order id, so the ref found can be checked against the id.
+  OrderRef refFor(OrderId clientOrderId) {
+    return OrderRef{1, OrderHandle{static_cast<uint32_t>(clientOrderId), 0}};
+  }
+
+  bool finds(ClientOrderIndex& index, ClientId clientId, OrderId clientOrderId) {
+    const auto ref = index.find(clientId, clientOrderId);
+    return ref && ref->handle.slot == clientOrderId;
+  }
+
+  struct Live {
+    std::unordered_set<uint32_t> slots;
+    bool operator()(const OrderRef& ref) const { return slots.count(ref.handle.slot) > 0; }
+  };
+
+  void idsBelowTheBase() {
+    ClientOrderIndex index;
+    Live live;
+    index.insert(1, 1000, refFor(1000), live);
+    index.insert(1, 500, refFor(500), live);
+    index.insert(2, 500, refFor(7), live);
+    expect(finds(index, 1, 1000) && finds(index, 1, 500), "ids at and below the client's first id are both found");
+    expect(index.find(2, 500)->handle.slot == 7, "each client has its own ids");
+
+    index.erase(1, 500, index.find(1, 500));
+    expect(!index.find(1, 500) && finds(index, 1, 1000), "erasing the id below the base leaves the other");
+    expect(!index.find(1, 999) && !index.find(3, 1000), "unknown ids and clients are not found");
+  }
+
+  /// Ids 1 to WINDOW, then one more, which slides the window; only even ids are still live at that point.
+  void fillAndSlide(ClientOrderIndex& index, Live& live) {
+    for (OrderId id = 1; id <= WINDOW; ++id) {
+      index.insert(1, id, refFor(id), live);
+      live.slots.insert(static_cast<uint32_t>(id));
+    }
+    for (OrderId id = 1; id <= WINDOW; id += 2) {
+      live.slots.erase(static_cast<uint32_t>(id));
+    }
+    index.insert(1, WINDOW + 1, refFor(WINDOW + 1), live);
+  }
+
+  void slideKeepsLiveOrders() {
+    ClientOrderIndex index;
+    Live live;
+    fillAndSlide(index, live);
+
+    // The new base is WINDOW / 2 + 2: everything below it left the window.
+    bool belowKept = true;
+    bool belowDropped = true;
+    for (OrderId id = 1; id < WINDOW / 2 + 2; ++id) {
+      if (id % 2 == 0) {
+        belowKept &= finds(index, 1, id);
+      } else {
+        belowDropped &= !index.find(1, id);
+      }
+    }
+    expect(belowKept, "live orders below the new window are still found");
+    expect(belowDropped, "filled orders below the new window are dropped");
+
+    bool insideKept = true;
+    for (OrderId id = WINDOW / 2 + 2; id <= WINDOW + 1; ++id) {
+      insideKept &= finds(index, 1, id);
+    }
+    expect(insideKept, "every id still inside the window is found at its new offset");
+  }
+
+  void eraseAfterSlide() {
+    ClientOrderIndex index;
+    Live live;
+    fillAndSlide(index, live);
+
+    const OrderId movedOut = 2;         // now in the hash fallback
+    const OrderId stillDense = WINDOW;  // shifted down the dense window
+    index.erase(1, movedOut, index.find(1, movedOut));
+    index.erase(1, stillDense, index.find(1, stillDense));
+    expect(!index.find(1, movedOut) && !index.find(1, stillDense), "entries on both sides of the slide can be erased");
+    expect(finds(index, 1, 4) && finds(index, 1, WINDOW - 1) && finds(index, 1, WINDOW + 1),
+           "their neighbours are untouched");
+  }
+
+  void sweepDropsFilledEntries() {
+    ClientOrderIndex index;
+    Live live;
+    expect(!index.sweep(live), "with nothing queued a sweep does nothing");
+
+    // The client starts high and then sends lower ids, which all go to the hash fallback; its window never
+    // slides, so only the idle sweep cleans up. Every third order is still live.
+    const OrderId base = 1'000'000;
+    index.insert(1, base, refFor(base), live);
+    for (OrderId id = 1; id <= ClientOrderIndex::MIN_SWEEP_SIZE; ++id) {
+      index.insert(1, id, refFor(id), live);
+      if (id % 3 == 0) {
+        live.slots.insert(static_cast<uint32_t>(id));
+      }
+    }
+    expect(!index.sweep(live), "the grown fallback was queued and swept, with no other client waiting");
+
+    bool kept = true;
+    bool dropped = true;
+    for (OrderId id = 1; id <= ClientOrderIndex::MIN_SWEEP_SIZE; ++id) {
+      if (id % 3 == 0) {
+        kept &= finds(index, 1, id);
+      } else {
+        dropped &= !index.find(1, id);
+      }
+    }
+    expect(kept, "the sweep keeps the live entries");
+    expect(dropped, "and drops the filled ones");
+    expect(finds(index, 1, base), "the dense entry is not swept");
+  }
+}
+
+int main() {
+  idsBelowTheBase();
+  slideKeepsLiveOrders();
+  eraseAfterSlide();
+  sweepDropsFilledEntries();
+  return TestHarness::finish();
+}
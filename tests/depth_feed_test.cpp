@@ -0,0 +1,110 @@
+#include <string>
+#include <utility>
+#include <vector>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// The L2 feed: a consumer that applies each NEW, CHANGE and DELETE as documented and keeps only the configured
+// depth must hold the book's top levels after every order, and no deltas are sent while the feed is off.
+
+namespace {
+  using TestHarness::expect;
+  using Levels = std::vector<std::pair<Price, Qty>>;
+
+  constexpr std::size_t DEPTH = 3;
+
+  struct Replica {
+    Levels sides[2];
+
+    void apply(const MarketData& data) {
+      auto& levels = sides[data.side == 'B' ? 0 : 1];
+      const auto rank = static_cast<std::ptrdiff_t>(data.depthLevel);
+      switch (data.depthAction) {
+        case MarketData::DepthAction::NEW:
+          levels.insert(levels.begin() + rank, {data.price, data.quantity});
+          if (levels.size() > DEPTH) {
+            levels.pop_back();
+          }
+          break;
+        case MarketData::DepthAction::CHANGE:
+          levels[rank].second = data.quantity;
+          break;
+        case MarketData::DepthAction::DELETE:
+          levels.erase(levels.begin() + rank);
+          break;
+        case MarketData::DepthAction::NONE:
+          break;
+      }
+    }
+  };
+
+  /// Apply everything published since the last call and return the depth records, in order.
+  std::vector<MarketData> update(moodycamel::ConcurrentQueue<MarketData>& queue, Replica& replica) {
+    std::vector<MarketData> deltas;
+    for (const auto& data : TestHarness::drain(queue)) {
+      if (data.type == MarketData::Type::DEPTH_UPDATE) {
+        replica.apply(data);
+        deltas.push_back(data);
+      }
+    }
+    return deltas;
+  }
+
+  void replicaFollowsTheBook() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.setDepthLevels(DEPTH);
+    Replica replica;
+
+    book.addOrder(2, 1, Side::SELL, 101, 5);
+    book.addOrder(2, 2, Side::SELL, 103, 5);
+    book.addOrder(2, 3, Side::SELL, 102, 5);
+    update(queue, replica);
+    expect(replica.sides[1] == Levels{{101, 5}, {102, 5}, {103, 5}}, "three offers are inserted in price order");
+
+    book.addOrder(2, 4, Side::SELL, 104, 5);
+    expect(update(queue, replica).empty(), "a level below the published depth sends nothing");
+
+    const auto inside = book.addOrder(2, 5, Side::SELL, 100, 2);
+    update(queue, replica);
+    expect(replica.sides[1] == Levels{{100, 2}, {101, 5}, {102, 5}}, "a better offer pushes 103 out of view");
+
+    book.cancelOrder(2, 5, inside);
+    const auto deltas = update(queue, replica);
+    expect(deltas.size() == 2 && deltas[0].depthAction == MarketData::DepthAction::DELETE && deltas[0].depthLevel == 0 &&
+           deltas[1].depthAction == MarketData::DepthAction::NEW && deltas[1].depthLevel == 2 && deltas[1].price == 103,
+           "cancelling the best offer deletes rank 0 and brings 103 back in at rank 2");
+
+    // Takes all of 101 and 3 of 102.
+    book.addOrder(1, 6, Side::BUY, 102, 8);
+    update(queue, replica);
+    expect(replica.sides[1] == Levels{{102, 2}, {103, 5}, {104, 5}}, "a sweep deletes 101, shrinks 102 and shows 104");
+    expect(replica.sides[0].empty(), "the filled buy never shows on the bid side");
+
+    book.addOrder(2, 7, Side::SELL, 102, 1);
+    const auto joined = update(queue, replica);
+    expect(joined.size() == 1 && joined[0].depthAction == MarketData::DepthAction::CHANGE && joined[0].quantity == 3,
+           "joining a level changes its quantity");
+
+    book.addOrder(1, 8, Side::BUY, 99, 4);
+    book.addOrder(1, 9, Side::BUY, 98, 4);
+    update(queue, replica);
+    expect(replica.sides[0] == Levels{{99, 4}, {98, 4}}, "bids are ranked from the highest");
+    expect(replica.sides[1] == Levels{{102, 3}, {103, 5}, {104, 5}}, "and leave the offers alone");
+  }
+
+  void offByDefault() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    Replica replica;
+    book.addOrder(2, 1, Side::SELL, 101, 5);
+    book.addOrder(1, 2, Side::BUY, 101, 2);
+    expect(update(queue, replica).empty(), "a book without depth levels publishes no deltas");
+  }
+}
+
+int main() {
+  replicaFollowsTheBook();
+  offByDefault();
+  return TestHarness::finish();
+}
@@ -0,0 +1,62 @@
+#include <string>
+#include "credit_risk.h"
+#include "test_harness.h"
+
+// The engine must never wait on the credit monitor: trades that find its queue full are dropped and their
+// clients blocked, and a flush that finds it full still reaches the monitor ahead of any later trade.
+
+namespace {
+  using TestHarness::expect;
+
+  FillRecord trade(ClientId aggressive, ClientId passive) {
+    return FillRecord{MarketData::Type::TRADE, 1, aggressive, passive, 'B', 100, 1};
+  }
+
+  void fullQueueDropsAndBlocks() {
+    Common::SPSCQueue<FillRecord> queue(2);
+    ClientCreditTable credit;
+    FillFeed feed(queue, credit);
+    feed.trade(trade(1, 2));
+    feed.trade(trade(1, 2));
+    feed.trade(trade(3, 4));
+    expect(feed.droppedTrades() == 1, "a trade that finds the queue full is dropped");
+    expect(credit.blocked(3) && credit.blocked(4), "both clients of a dropped trade are blocked");
+    expect(!credit.blocked(1) && !credit.blocked(2), "clients whose trades got through are not");
+
+    // The flush cannot be pushed yet, so a trade behind it is dropped rather than overtaking it.
+    feed.flush();
+    feed.trade(trade(5, 3));
+    expect(feed.droppedTrades() == 2, "a trade behind a held-back flush is dropped");
+
+    FillRecord record;
+    queue.tryPop(record);
+    queue.tryPop(record);
+    feed.retry();
+    expect(queue.tryPop(record) && record.type == MarketData::Type::FLUSH, "the held-back flush is pushed when room frees");
+    expect(!credit.blocked(4), "the flush unblocks clients whose lost fills it closed");
+    expect(credit.blocked(3) && credit.blocked(5), "clients that lost a fill after the flush stay blocked");
+
+    feed.flush();
+    expect(!credit.blocked(3) && !credit.blocked(5), "the next flush unblocks them");
+  }
+
+  void monitorKeepsItsOwnBlock() {
+    ClientCreditTable credit;
+    Common::SPSCQueue<FillRecord> queue(1);
+    FillFeed feed(queue, credit);
+    credit.publish(7, CreditState{0, 10, 0});
+    feed.trade(trade(8, 9));
+    feed.trade(trade(7, 9));
+    FillRecord record;
+    queue.tryPop(record);
+    feed.flush();
+    expect(credit.blocked(7), "clearing a stale mark leaves a client with no headroom blocked");
+  }
+}
+
+int main() {
+  fullQueueDropsAndBlocks();
+  monitorKeepsItsOwnBlock();
+
+  return TestHarness::finish();
+}
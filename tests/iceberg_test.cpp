@@ -0,0 +1,89 @@
+#include <string>
+#include <utility>
+#include <vector>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// An iceberg shows only a slice of its quantity. Each slice traded away is replenished from the reserve at the
+// back of its level's queue, so orders that arrived while the slice was shown trade before the next one.
+
+namespace {
+  using TestHarness::expect;
+
+  constexpr ClientId ICEBERG = 1;
+  constexpr ClientId OTHER = 2;
+  constexpr ClientId BUYER = 9;
+
+  /// Passive client of each fill, in order, for a buy of quantity at 100.
+  std::vector<std::pair<ClientId, Qty>> buy(OrderBook& book, moodycamel::ConcurrentQueue<MarketData>& queue,
+                                            OrderId clientOrderId, Qty quantity) {
+    TestHarness::drain(queue);
+    book.addOrder(BUYER, clientOrderId, Side::BUY, 100, quantity);
+    std::vector<std::pair<ClientId, Qty>> fills;
+    for (const auto& data : TestHarness::drain(queue)) {
+      if (data.type == MarketData::Type::TRADE) {
+        fills.emplace_back(data.passiveClientId, data.quantity);
+      }
+    }
+    return fills;
+  }
+
+  void onlyTheSliceIsShown() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(ICEBERG, 1, Side::SELL, 100, 25, TimeInForce::DAY, 10);
+    Qty shown = 0;
+    for (const auto& data : TestHarness::drain(queue)) {
+      if (data.type == MarketData::Type::BOOK_UPDATE) {
+        shown = data.quantity;
+      }
+    }
+    expect(shown == 10, "an iceberg of 25 shows 10");
+  }
+
+  void replenishGoesToTheBack() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(ICEBERG, 1, Side::SELL, 100, 25, TimeInForce::DAY, 10);
+    book.addOrder(OTHER, 1, Side::SELL, 100, 5);
+
+    // The first slice trades, the next goes behind OTHER, which trades before it.
+    const auto fills = buy(book, queue, 1, 17);
+    const std::vector<std::pair<ClientId, Qty>> expected = {{ICEBERG, 10}, {OTHER, 5}, {ICEBERG, 2}};
+    expect(fills == expected, "a buy of 17 fills 10 of the slice, then OTHER's 5, then 2 of the new slice");
+  }
+
+  void reserveRunsOut() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    const auto iceberg = book.addOrder(ICEBERG, 1, Side::SELL, 100, 25, TimeInForce::DAY, 10);
+
+    const auto fills = buy(book, queue, 1, 30);
+    Qty traded = 0;
+    for (const auto& [clientId, quantity] : fills) {
+      traded += quantity;
+    }
+    expect(fills.size() == 3 && traded == 25, "a buy of 30 takes the whole iceberg in slices of 10, 10 and 5");
+    expect(!book.holds(iceberg), "once the reserve is used up the iceberg leaves the book");
+  }
+
+  void sizeDownComesOutOfTheReserve() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    const auto iceberg = book.addOrder(ICEBERG, 1, Side::SELL, 100, 25, TimeInForce::DAY, 10);
+    book.addOrder(OTHER, 1, Side::SELL, 100, 5);
+    book.modifyOrder(ICEBERG, 1, iceberg, 100, 12);
+
+    const auto fills = buy(book, queue, 1, 20);
+    const std::vector<std::pair<ClientId, Qty>> expected = {{ICEBERG, 10}, {OTHER, 5}, {ICEBERG, 2}};
+    expect(fills == expected, "an amend to 12 keeps the shown 10 in place and leaves a reserve of 2");
+  }
+}
+
+int main() {
+  onlyTheSliceIsShown();
+  replenishGoesToTheBack();
+  reserveRunsOut();
+  sizeDownComesOutOfTheReserve();
+  return TestHarness::finish();
+}
@@ -0,0 +1,75 @@
+#include <map>
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// Order-by-order detail: every record a book publishes carries the next of its own gap-free sequence numbers,
+// and ADD, CANCEL, MODIFY and TRADE name orders by the exchange id the ADD assigned, with what is left of them.
+
+namespace {
+  using TestHarness::expect;
+
+  void sequencesAreGapFreePerBook() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook first(1, &queue, 64);
+    OrderBook second(2, &queue, 64);
+    first.setDepthLevels(2);
+
+    const auto resting = first.addOrder(2, 1, Side::SELL, 100, 10);
+    second.addOrder(2, 1, Side::SELL, 50, 10);
+    first.addOrder(1, 2, Side::BUY, 100, 4);
+    second.addOrder(1, 2, Side::BUY, 49, 10);
+    first.modifyOrder(2, 1, resting, 100, 5);
+    first.cancelOrder(2, 1, resting);
+
+    std::map<TickerId, uint64_t> lastSequence;
+    bool gapFree = true;
+    for (const auto& data : TestHarness::drain(queue)) {
+      gapFree &= data.sequence == ++lastSequence[data.tickerId];
+    }
+    expect(gapFree, "each book numbers its records 1, 2, 3, ... across every record type");
+    expect(lastSequence[1] > lastSequence[2], "the books count independently");
+  }
+
+  void ordersAreNamedByExchangeId() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    const auto resting = book.addOrder(2, 7, Side::SELL, 100, 10);
+    book.addOrder(1, 7, Side::BUY, 100, 4);
+    book.modifyOrder(2, 7, resting, 100, 5);
+    book.cancelOrder(2, 7, resting);
+
+    std::map<ClientId, OrderId> exchangeIds;
+    std::vector<MarketData> events;
+    for (const auto& data : TestHarness::drain(queue)) {
+      if (data.type == MarketData::Type::ADD) {
+        exchangeIds[data.aggressiveClientId] = data.aggressiveMarketOrderId;
+        expect(data.aggressiveRemaining == data.quantity, "an ADD carries the whole order");
+      } else if (data.type != MarketData::Type::BOOK_UPDATE) {
+        events.push_back(data);
+      }
+    }
+    const auto sellId = exchangeIds[2];
+    const auto buyId = exchangeIds[1];
+    expect(sellId != 0 && buyId != 0 && sellId != buyId, "both orders get distinct exchange ids, though their client ids match");
+
+    expect(events.size() == 3, "a trade, an amend and a cancel follow the adds");
+    if (events.size() == 3) {
+      const auto& trade = events[0];
+      expect(trade.type == MarketData::Type::TRADE && trade.aggressiveMarketOrderId == buyId &&
+             trade.passiveMarketOrderId == sellId, "the trade names the buy as aggressor and the sell as passive");
+      expect(trade.aggressiveRemaining == 0 && trade.passiveRemaining == 6, "and what each has left: 0 and 6");
+      expect(events[1].type == MarketData::Type::MODIFY && events[1].aggressiveMarketOrderId == sellId &&
+             events[1].aggressiveRemaining == 5, "the amend names the sell, now at 5");
+      expect(events[2].type == MarketData::Type::CANCEL && events[2].aggressiveMarketOrderId == sellId &&
+             events[2].aggressiveRemaining == 0, "the cancel names the sell, with nothing left");
+    }
+  }
+}
+
+int main() {
+  sequencesAreGapFreePerBook();
+  ordersAreNamedByExchangeId();
+  return TestHarness::finish();
+}
@@ -0,0 +1,98 @@
+#include <map>
+#include <string>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// With lazy cancels a cancelled order that is not alone on its level stays queued as a tombstone: the level's
+// totals drop at once, compaction frees it later, and matching never trades against it in between.
+
+namespace {
+  using TestHarness::expect;
+
+  constexpr ClientId BUYER = 9;
+
+  /// Sells of 10 at 100 from clients 1, 2 and 3, in that order, with client 2's cancelled.
+  struct Book {
+    moodycamel::ConcurrentQueue<MarketData> queue{256};
+    OrderBook book{1, &queue, 64};
+    OrderHandle cancelled;
+
+    Book() {
+      book.setLazyCancels(true);
+      book.addOrder(1, 1, Side::SELL, 100, 10);
+      cancelled = book.addOrder(2, 2, Side::SELL, 100, 10);
+      book.addOrder(3, 3, Side::SELL, 100, 10);
+      book.cancelOrder(2, 2, cancelled);
+    }
+
+    /// Quantity each resting client sold to a buy of quantity at 100.
+    std::map<ClientId, Qty> buy(Qty quantity) {
+      TestHarness::drain(queue);
+      book.addOrder(BUYER, 4, Side::BUY, 100, quantity);
+      std::map<ClientId, Qty> sold;
+      for (const auto& data : TestHarness::drain(queue)) {
+        if (data.type == MarketData::Type::TRADE) {
+          sold[data.passiveClientId] += data.quantity;
+        }
+      }
+      return sold;
+    }
+  };
+
+  void cancelLeavesATombstone() {
+    Book fixture;
+    Qty offered = 0;
+    bool cancelled = false;
+    for (const auto& data : TestHarness::drain(fixture.queue)) {
+      if (data.type == MarketData::Type::BOOK_UPDATE && data.side == 'S') {
+        offered = data.quantity;
+      }
+      cancelled |= data.type == MarketData::Type::CANCEL && data.aggressiveClientId == 2;
+    }
+    expect(cancelled, "the cancel is published");
+    expect(offered == 20, "the offer drops to 20 as soon as the order is cancelled");
+    expect(fixture.book.hasTombstones() && !fixture.book.holds(fixture.cancelled),
+           "the cancelled order is a tombstone and its handle is stale");
+  }
+
+  void compactThenRematch() {
+    Book fixture;
+    expect(fixture.book.compactTombstones(16) == 0 && !fixture.book.hasTombstones(), "compaction frees the tombstone");
+    const auto sold = fixture.buy(30);
+    expect(sold.size() == 2 && sold.at(1) == 10 && sold.at(3) == 10, "after compaction a buy of 30 trades 10 with 1 and 3");
+  }
+
+  void matchSkipsTombstones() {
+    Book fixture;
+    const auto sold = fixture.buy(15);
+    expect(sold.size() == 2 && sold.at(1) == 10 && sold.at(3) == 5, "a buy of 15 steps over the tombstone to client 3");
+    // Matching freed it already, so compaction finds its handle stale.
+    expect(fixture.book.compactTombstones(16) == 0, "compaction after the match has nothing left to do");
+    const auto rest = fixture.buy(10);
+    expect(rest.size() == 1 && rest.at(3) == 5, "client 3's remaining 5 still trades");
+  }
+
+  void lastOrderIsRemovedOutright() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.setLazyCancels(true);
+    const auto handle = book.addOrder(1, 1, Side::SELL, 100, 10);
+    book.cancelOrder(1, 1, handle);
+    expect(!book.hasTombstones(), "the only order on a level is not buried");
+    TestHarness::drain(queue);
+    book.addOrder(BUYER, 2, Side::BUY, 100, 10);
+    bool traded = false;
+    for (const auto& data : TestHarness::drain(queue)) {
+      traded |= data.type == MarketData::Type::TRADE;
+    }
+    expect(!traded, "a buy finds nothing left at 100");
+  }
+}
+
+int main() {
+  cancelLeavesATombstone();
+  compactThenRematch();
+  matchSkipsTombstones();
+  lastOrderIsRemovedOutright();
+  return TestHarness::finish();
+}
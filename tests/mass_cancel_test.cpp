@@ -0,0 +1,95 @@
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// A mass cancel withdraws every order one client has on the chosen sides, stops and pegs included, as CANCELs
+// with the message Mass cancel, and touches nobody else's. Each side's depth gets one set of deltas and its
+// top of book one update.
+
+namespace {
+  using TestHarness::expect;
+
+  constexpr ClientId CLIENT = 1;
+  constexpr ClientId OTHER = 2;
+
+  struct Book {
+    moodycamel::ConcurrentQueue<MarketData> queue{256};
+    OrderBook book{1, &queue, 64};
+    std::vector<OrderHandle> clientBuys;
+    std::vector<OrderHandle> clientSells;
+    std::vector<OrderHandle> others;
+
+    Book() {
+      book.setDepthLevels(3);
+      clientBuys.push_back(book.addOrder(CLIENT, 1, Side::BUY, 100, 5));
+      others.push_back(book.addOrder(OTHER, 1, Side::BUY, 100, 5));
+      clientBuys.push_back(book.addOrder(CLIENT, 2, Side::BUY, 99, 5));
+      clientBuys.push_back(book.addStopOrder(CLIENT, 3, Side::BUY, 110, 0, 5));
+      clientBuys.push_back(book.addPegOrder(CLIENT, 4, Side::BUY, PegType::PRIMARY, 5));
+      clientSells.push_back(book.addOrder(CLIENT, 5, Side::SELL, 102, 5));
+      others.push_back(book.addOrder(OTHER, 2, Side::SELL, 103, 5));
+      TestHarness::drain(queue);
+    }
+  };
+
+  bool allHeld(const OrderBook& book, const std::vector<OrderHandle>& handles, bool held) {
+    for (const auto& handle : handles) {
+      if (book.holds(handle) != held) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void cancelsOnlyTheClientsChosenSide() {
+    Book fixture;
+    const auto cancelled = fixture.book.massCancel(CLIENT, true, false);
+    expect(cancelled == 4, "the client's two bids, buy stop and buy peg are cancelled");
+    expect(allHeld(fixture.book, fixture.clientBuys, false), "none of the client's buys is left");
+    expect(allHeld(fixture.book, fixture.clientSells, true), "the client's sell stays");
+    expect(allHeld(fixture.book, fixture.others, true), "the other client's orders stay");
+
+    std::size_t cancels = 0;
+    std::vector<MarketData> updates;
+    std::vector<MarketData> deltas;
+    for (const auto& data : TestHarness::drain(fixture.queue)) {
+      if (data.type == MarketData::Type::CANCEL) {
+        cancels += data.message == "Mass cancel" && data.aggressiveClientId == CLIENT;
+      } else if (data.type == MarketData::Type::BOOK_UPDATE) {
+        updates.push_back(data);
+      } else if (data.type == MarketData::Type::DEPTH_UPDATE) {
+        deltas.push_back(data);
+      }
+    }
+    expect(cancels == 4, "each is reported as a Mass cancel");
+    expect(updates.size() == 1 && updates[0].side == 'B' && updates[0].price == 100 && updates[0].quantity == 5,
+           "the bid is published once, as the other client's 5 at 100");
+    expect(deltas.size() == 2 && deltas[0].depthAction == MarketData::DepthAction::CHANGE && deltas[0].depthLevel == 0 &&
+           deltas[0].quantity == 5 && deltas[1].depthAction == MarketData::DepthAction::DELETE && deltas[1].depthLevel == 1,
+           "the bid depth gets one CHANGE at 100 and one DELETE for 99");
+  }
+
+  void bothSidesAndNothingLeft() {
+    Book fixture;
+    expect(fixture.book.massCancel(CLIENT, true, true) == 5, "cancelling both sides takes all five of the client's orders");
+    expect(allHeld(fixture.book, fixture.others, true), "and still none of the other client's");
+    TestHarness::drain(fixture.queue);
+    expect(fixture.book.massCancel(CLIENT, true, true) == 0 && TestHarness::drain(fixture.queue).empty(),
+           "a second mass cancel finds nothing and publishes nothing");
+  }
+
+  void filledOrdersAreNotOwned() {
+    Book fixture;
+    // OTHER takes the client's sell at 102.
+    fixture.book.addOrder(OTHER, 3, Side::BUY, 102, 5);
+    expect(fixture.book.massCancel(CLIENT, false, true) == 0, "a filled order is no longer the client's to cancel");
+  }
+}
+
+int main() {
+  cancelsOnlyTheClientsChosenSide();
+  bothSidesAndNothingLeft();
+  filledOrdersAreNotOwned();
+  return TestHarness::finish();
+}
@@ -0,0 +1,77 @@
+#include <map>
+#include <string>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// Pro-rata matching shares an incoming order out over a level in proportion to the resting sizes, with the
+// rounding remainder going to the front of the queue; under top-order pro-rata the order that opened the best
+// level is filled first and only the rest is shared out.
+
+namespace {
+  using TestHarness::expect;
+
+  constexpr ClientId AGGRESSOR = 9;
+
+  struct Sell {
+    ClientId clientId;
+    Qty quantity;
+  };
+
+  /// Rest the sells at 100 in order, then buy quantity at 100 and report what each resting client sold.
+  template<std::size_t N>
+  std::map<ClientId, Qty> allocate(MatchingPolicy policy, const Sell (&sells)[N], Qty quantity) {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.setMatchingPolicy(policy);
+    OrderId nextClientOrderId = 1;
+    for (const auto& sell : sells) {
+      book.addOrder(sell.clientId, nextClientOrderId++, Side::SELL, 100, sell.quantity);
+    }
+    TestHarness::drain(queue);
+
+    book.addOrder(AGGRESSOR, nextClientOrderId, Side::BUY, 100, quantity);
+    std::map<ClientId, Qty> sold;
+    for (const auto& data : TestHarness::drain(queue)) {
+      if (data.type == MarketData::Type::TRADE) {
+        sold[data.passiveClientId] += data.quantity;
+      }
+    }
+    return sold;
+  }
+
+  void sharesFollowRestingSize() {
+    const Sell sells[] = {{1, 30}, {2, 10}, {3, 60}};
+    auto sold = allocate(MatchingPolicy::PRO_RATA, sells, 50);
+    expect(sold[1] == 15 && sold[2] == 5 && sold[3] == 30, "pro-rata: 50 against 30/10/60 is split 15/5/30");
+
+    sold = allocate(MatchingPolicy::FIFO, sells, 50);
+    expect(sold[1] == 30 && sold[2] == 10 && sold[3] == 10, "FIFO: 50 against 30/10/60 fills in queue order");
+  }
+
+  void remainderGoesToTheFront() {
+    const Sell sells[] = {{1, 1}, {2, 1}, {3, 1}};
+    auto sold = allocate(MatchingPolicy::PRO_RATA, sells, 2);
+    expect(sold[1] == 1 && sold[2] == 1 && sold[3] == 0, "pro-rata: 2 against 1/1/1 rounds in favour of the front");
+  }
+
+  void topOrderIsFilledFirst() {
+    // Client 1 opened the level, so it is the top order: filled outright, then 40 is split 20/20.
+    const Sell sells[] = {{1, 20}, {2, 40}, {3, 40}};
+    auto sold = allocate(MatchingPolicy::TOP_ORDER_PRO_RATA, sells, 60);
+    expect(sold[1] == 20 && sold[2] == 20 && sold[3] == 20, "top-order pro-rata: 60 against 20/40/40 is 20/20/20");
+
+    sold = allocate(MatchingPolicy::PRO_RATA, sells, 60);
+    expect(sold[1] == 12 && sold[2] == 24 && sold[3] == 24, "pro-rata: 60 against 20/40/40 is 12/24/24");
+
+    // The priority share is capped at the incoming quantity.
+    sold = allocate(MatchingPolicy::TOP_ORDER_PRO_RATA, sells, 15);
+    expect(sold[1] == 15 && sold[2] == 0 && sold[3] == 0, "top-order pro-rata: 15 goes to the top order alone");
+  }
+}
+
+int main() {
+  sharesFollowRestingSize();
+  remainderGoesToTheFront();
+  topOrderIsFilledFirst();
+  return TestHarness::finish();
+}
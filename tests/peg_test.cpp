@@ -0,0 +1,102 @@
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// Pegged orders are priced from the displayed touch whenever something trades against them: a move of the best
+// bid or offer reprices them without touching them. They trade behind displayed orders at the same price, and
+// two pegs that a move of the touch leaves overlapping trade with each other.
+
+namespace {
+  using TestHarness::expect;
+
+  constexpr ClientId PEG_OWNER = 1;
+  constexpr ClientId BIDDER = 2;
+  constexpr ClientId OFFERER = 3;
+  constexpr ClientId OTHER_PEG_OWNER = 4;
+  constexpr ClientId TAKER = 9;
+
+  std::vector<MarketData> tradesIn(const std::vector<MarketData>& records) {
+    std::vector<MarketData> trades;
+    for (const auto& data : records) {
+      if (data.type == MarketData::Type::TRADE) {
+        trades.push_back(data);
+      }
+    }
+    return trades;
+  }
+
+  void midpointFollowsTheTouch() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(BIDDER, 1, Side::BUY, 98, 5);
+    book.addOrder(OFFERER, 1, Side::SELL, 102, 5);
+    book.addPegOrder(PEG_OWNER, 1, Side::SELL, PegType::MIDPOINT, 5);
+    TestHarness::drain(queue);
+
+    book.addOrder(TAKER, 1, Side::BUY, 100, 2, TimeInForce::IOC);
+    auto trades = tradesIn(TestHarness::drain(queue));
+    expect(trades.size() == 1 && trades[0].passiveClientId == PEG_OWNER && trades[0].price == 100 && trades[0].quantity == 2,
+           "between 98 and 102 the midpoint sell trades at 100");
+
+    // A better bid moves the midpoint to 101 (sells round up).
+    book.addOrder(BIDDER, 2, Side::BUY, 99, 5);
+    TestHarness::drain(queue);
+    book.addOrder(TAKER, 2, Side::BUY, 100, 1, TimeInForce::IOC);
+    expect(tradesIn(TestHarness::drain(queue)).empty(), "once the bid is 99 the peg no longer trades at 100");
+    book.addOrder(TAKER, 3, Side::BUY, 101, 1, TimeInForce::IOC);
+    trades = tradesIn(TestHarness::drain(queue));
+    expect(trades.size() == 1 && trades[0].passiveClientId == PEG_OWNER && trades[0].price == 101, "it trades at 101");
+  }
+
+  void primaryQueuesBehindDisplayedOrders() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addPegOrder(PEG_OWNER, 1, Side::BUY, PegType::PRIMARY, 5);
+    book.addOrder(BIDDER, 1, Side::BUY, 100, 5);
+    TestHarness::drain(queue);
+
+    book.addOrder(TAKER, 1, Side::SELL, 100, 7);
+    const auto trades = tradesIn(TestHarness::drain(queue));
+    expect(trades.size() == 2 && trades[0].passiveClientId == BIDDER && trades[0].quantity == 5 &&
+           trades[1].passiveClientId == PEG_OWNER && trades[1].quantity == 2 && trades[1].price == 100,
+           "a primary buy peg joins the bid but trades after the displayed 5, though it arrived first");
+  }
+
+  void marketPegSitsInsideTheSpread() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(BIDDER, 1, Side::BUY, 100, 5);
+    book.addOrder(OFFERER, 1, Side::SELL, 105, 5);
+    book.addPegOrder(PEG_OWNER, 1, Side::SELL, PegType::MARKET, 5);
+    TestHarness::drain(queue);
+
+    book.addOrder(TAKER, 1, Side::BUY, 101, 5, TimeInForce::IOC);
+    const auto trades = tradesIn(TestHarness::drain(queue));
+    expect(trades.size() == 1 && trades[0].passiveClientId == PEG_OWNER && trades[0].price == 101,
+           "a market sell peg sits one tick above the bid");
+  }
+
+  void overlappingPegsTrade() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(BIDDER, 1, Side::BUY, 98, 5);
+    book.addOrder(OFFERER, 1, Side::SELL, 102, 5);
+    // Market pegs sit one tick inside the far side: the buy at 101, the sell at 99.
+    book.addPegOrder(PEG_OWNER, 1, Side::BUY, PegType::MARKET, 3);
+    TestHarness::drain(queue);
+    book.addPegOrder(OTHER_PEG_OWNER, 1, Side::SELL, PegType::MARKET, 3);
+    const auto trades = tradesIn(TestHarness::drain(queue));
+    expect(trades.size() == 1 && trades[0].aggressiveClientId == OTHER_PEG_OWNER &&
+           trades[0].passiveClientId == PEG_OWNER && trades[0].price == 101 && trades[0].quantity == 3,
+           "overlapping pegs trade at once, at the older peg's price");
+  }
+}
+
+int main() {
+  midpointFollowsTheTouch();
+  primaryQueuesBehindDisplayedOrders();
+  marketPegSitsInsideTheSpread();
+  overlappingPegsTrade();
+  return TestHarness::finish();
+}
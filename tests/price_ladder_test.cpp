@@ -0,0 +1,145 @@
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "PriceLadder.h"
+#include "test_harness.h"
+
+// Prices far apart must not stretch a ladder's window without bound: once it is at its widest, levels outside it
+// live in the overflow map and still rank, match and retire in price order with the rest.
+
+namespace {
+  using TestHarness::expect;
+
+  template<Side S>
+  std::vector<Price> pricesOf(const PriceLadder<S>& ladder) {
+    std::vector<Price> prices;
+    for (auto level = ladder.best(); level; level = ladder.next(level)) {
+      prices.push_back(level->price);
+    }
+    return prices;
+  }
+
+  void ladderKeepsOutlyingLevelsInOrder() {
+    LevelPool pool(16, 16);
+    PriceLadder<Side::SELL> asks(pool);
+    for (Price price : {Price{1}, Price{2'000'000'000}, Price{500}, Price{1'999'999'990}, Price{3}}) {
+      asks.findOrCreate(price);
+    }
+    expect(asks.bandTicks() <= MAX_PRICE_BAND_TICKS, "window stays within the widest band");
+    expect(asks.size() == 5, "every level is live");
+    expect(pricesOf(asks) == std::vector<Price>{1, 3, 500, 1'999'999'990, 2'000'000'000}, "asks rank low to high");
+    expect(asks.find(2'000'000'000) && asks.find(2'000'000'000) == asks.findOrCreate(2'000'000'000),
+           "an overflow level is found, not created twice");
+    expect(!asks.find(2'000'000'001), "an absent outlying price is not found");
+
+    asks.erase(asks.find(1'999'999'990));
+    asks.retireBefore(asks.find(500));
+    expect(pricesOf(asks) == std::vector<Price>{500, 2'000'000'000}, "erase and retire take levels out of both");
+
+    // With the low levels gone the window can reach the outlier again and takes it back from the overflow map.
+    asks.erase(asks.find(500));
+    asks.findOrCreate(2'000'000'005);
+    expect(pricesOf(asks) == std::vector<Price>{2'000'000'000, 2'000'000'005}, "levels survive recentering");
+    asks.findOrCreate(7);
+    expect(pricesOf(asks) == std::vector<Price>{7, 2'000'000'000, 2'000'000'005}, "a new low level ranks first");
+
+    LevelPool bidPool(16, 16);
+    PriceLadder<Side::BUY> bids(bidPool);
+    for (Price price : {Price{2'000'000'000}, Price{1}, Price{1'500'000'000}, Price{2}}) {
+      bids.findOrCreate(price);
+    }
+    expect(pricesOf(bids) == std::vector<Price>{2'000'000'000, 1'500'000'000, 2, 1}, "bids rank high to low");
+  }
+
+  void bookMatchesAcrossTheOverflow() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(1, 1, Side::SELL, 1, 10);
+    book.addOrder(1, 2, Side::SELL, 2'000'000'000, 10);
+    book.addOrder(1, 3, Side::SELL, 1'000, 10);
+    MarketData data;
+    while (queue.try_dequeue(data)) {}
+
+    book.addOrder(2, 1, Side::BUY, 2'000'000'000, 30);
+    std::vector<Price> tradePrices;
+    while (queue.try_dequeue(data)) {
+      if (data.type == MarketData::Type::TRADE) {
+        tradePrices.push_back(data.price);
+      }
+    }
+    expect(tradePrices == std::vector<Price>{1, 1'000, 2'000'000'000}, "a sweep trades through outlying levels in order");
+  }
+
+  // The level pool starts small and grows in chunks; levels already handed out never move.
+  void levelPoolGrowsInPlace() {
+    LevelPool pool(4, 64);
+    PriceLadder<Side::BUY> bids(pool);
+    std::vector<OrdersAtPrice*> levels;
+    for (Price price = 100; price < 140; ++price) {
+      levels.push_back(bids.findOrCreate(price));
+    }
+    expect(pool.capacity() >= 40 && pool.capacity() <= 64, "the pool grows to fit 40 levels, within its maximum");
+    bool stable = true;
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+      stable &= levels[i]->price == 100 + static_cast<Price>(i) && bids.find(levels[i]->price) == levels[i];
+    }
+    expect(stable, "levels created before the pool grew are still in place");
+    expect(bids.size() == 40 && bids.best()->price == 139, "and still ranked");
+
+    // Freed levels in the first chunk are reused before anything is added.
+    const auto capacity = pool.capacity();
+    for (Price price = 100; price < 104; ++price) {
+      bids.erase(bids.find(price));
+    }
+    for (Price price = 90; price < 94; ++price) {
+      bids.findOrCreate(price);
+    }
+    expect(pool.capacity() == capacity && bids.size() == 40, "freed levels are reused");
+
+    bids.forgetAll();
+    pool.releaseAll();
+    for (Price price = 0; price < 40; ++price) {
+      bids.findOrCreate(price + 1);
+    }
+    expect(pool.capacity() == capacity && bids.size() == 40, "after a release the grown pool is reused whole");
+  }
+
+  // A reset drops levels by epoch without clearing their slots, so nothing from before it may show through.
+  void resetLeavesNothingBehind() {
+    moodycamel::ConcurrentQueue<MarketData> queue(1024);
+    OrderBook book(1, &queue, 64);
+    const auto oldHandle = book.addOrder(1, 1, Side::SELL, 100, 10);
+    book.addOrder(1, 2, Side::SELL, 101, 10);
+    book.addOrder(1, 3, Side::BUY, 90, 10);
+    book.addOrder(1, 4, Side::SELL, 2'000'000'000, 10);
+    book.reset();
+    MarketData data;
+    while (queue.try_dequeue(data)) {}
+
+    expect(!book.holds(oldHandle), "handles from before the reset are stale");
+    expect(book.referencePrice() == 0, "a reset book has no reference price");
+    expect(book.massCancel(1, true, true) == 0, "client lists from before the reset are empty");
+
+    book.addOrder(2, 1, Side::SELL, 101, 5);
+    book.addOrder(3, 1, Side::BUY, 2'000'000'000, 20);
+    std::vector<Price> tradePrices;
+    Qty traded = 0;
+    while (queue.try_dequeue(data)) {
+      if (data.type == MarketData::Type::TRADE) {
+        tradePrices.push_back(data.price);
+        traded += data.quantity;
+      }
+    }
+    expect(tradePrices == std::vector<Price>{101} && traded == 5, "only orders entered after the reset trade");
+    expect(book.massCancel(3, true, true) == 1, "a client's list is rebuilt after the reset");
+  }
+}
+
+int main() {
+  ladderKeepsOutlyingLevelsInOrder();
+  bookMatchesAcrossTheOverflow();
+  levelPoolGrowsInPlace();
+  resetLeavesNothingBehind();
+
+  return TestHarness::finish();
+}
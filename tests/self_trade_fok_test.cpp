@@ -0,0 +1,100 @@
+#include <string>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// A fill-or-kill order must trade its whole quantity or nothing, also when self-trade prevention stops it
+// trading with the client's own resting orders.
+
+namespace {
+  constexpr ClientId OWN_CLIENT = 1;
+  constexpr ClientId OTHER_CLIENT = 2;
+
+  struct Outcome {
+    Qty traded = 0;
+    bool killed = false;
+    bool selfTradeCancels = false;
+  };
+
+  struct Sell {
+    ClientId clientId;
+    Price price;
+    Qty quantity;
+  };
+
+  /// Rest the sells, then send OWN_CLIENT's FOK buy and report what it did.
+  template<std::size_t N>
+  Outcome sendFok(SelfTradePrevention mode, const Sell (&sells)[N], Price price, Qty quantity) {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.setSelfTradePrevention(mode);
+    OrderId nextClientOrderId = 1;
+    for (const auto& sell : sells) {
+      book.addOrder(sell.clientId, nextClientOrderId++, Side::SELL, sell.price, sell.quantity);
+    }
+    MarketData data;
+    while (queue.try_dequeue(data)) {}
+
+    book.addOrder(OWN_CLIENT, nextClientOrderId, Side::BUY, price, quantity, TimeInForce::FOK);
+    Outcome outcome;
+    while (queue.try_dequeue(data)) {
+      if (data.type == MarketData::Type::TRADE) {
+        outcome.traded += data.quantity;
+      } else if (data.type == MarketData::Type::CANCEL && data.message == "Killed") {
+        outcome.killed = true;
+      } else if (data.message == "Self-trade") {
+        outcome.selfTradeCancels = true;
+      }
+    }
+    return outcome;
+  }
+
+  using TestHarness::expect;
+
+  const char* name(SelfTradePrevention mode) {
+    switch (mode) {
+      case SelfTradePrevention::NONE: return "NONE";
+      case SelfTradePrevention::CANCEL_NEWEST: return "CANCEL_NEWEST";
+      case SelfTradePrevention::CANCEL_OLDEST: return "CANCEL_OLDEST";
+      case SelfTradePrevention::CANCEL_BOTH: return "CANCEL_BOTH";
+      case SelfTradePrevention::DECREMENT: return "DECREMENT";
+    }
+    return "?";
+  }
+}
+
+int main() {
+  // Half the liquidity at the limit is the client's own: only without prevention can the FOK fill.
+  const Sell halfOwn[] = {{OWN_CLIENT, 100, 10}, {OTHER_CLIENT, 100, 10}};
+  for (auto mode : {SelfTradePrevention::CANCEL_NEWEST, SelfTradePrevention::CANCEL_OLDEST,
+                    SelfTradePrevention::CANCEL_BOTH, SelfTradePrevention::DECREMENT}) {
+    const auto outcome = sendFok(mode, halfOwn, 100, 20);
+    expect(outcome.killed && outcome.traded == 0 && !outcome.selfTradeCancels,
+           std::string(name(mode)) + ": FOK for 20 against 10 own + 10 other is killed untouched");
+  }
+  const auto unprevented = sendFok(SelfTradePrevention::NONE, halfOwn, 100, 20);
+  expect(!unprevented.killed && unprevented.traded == 20, "NONE: FOK trades with the client's own order");
+
+  // Enough other liquidity: CANCEL_OLDEST cancels the own order on the way and still fills completely.
+  const Sell otherCovers[] = {{OWN_CLIENT, 100, 10}, {OTHER_CLIENT, 100, 20}};
+  const auto oldest = sendFok(SelfTradePrevention::CANCEL_OLDEST, otherCovers, 100, 20);
+  expect(!oldest.killed && oldest.traded == 20 && oldest.selfTradeCancels,
+         "CANCEL_OLDEST: FOK fills from other clients after cancelling its own order");
+  // The other modes would cut the FOK short on reaching the own order, which is at the front of the level.
+  for (auto mode : {SelfTradePrevention::CANCEL_NEWEST, SelfTradePrevention::CANCEL_BOTH,
+                    SelfTradePrevention::DECREMENT}) {
+    const auto outcome = sendFok(mode, otherCovers, 100, 20);
+    expect(outcome.killed && outcome.traded == 0,
+           std::string(name(mode)) + ": FOK that would reach its own order is killed");
+  }
+
+  // Filled entirely ahead of the own order's price, the FOK never meets it under any mode.
+  const Sell ownBehind[] = {{OTHER_CLIENT, 99, 20}, {OWN_CLIENT, 100, 10}};
+  for (auto mode : {SelfTradePrevention::CANCEL_NEWEST, SelfTradePrevention::CANCEL_OLDEST,
+                    SelfTradePrevention::CANCEL_BOTH, SelfTradePrevention::DECREMENT}) {
+    const auto outcome = sendFok(mode, ownBehind, 100, 20);
+    expect(!outcome.killed && outcome.traded == 20 && !outcome.selfTradeCancels,
+           std::string(name(mode)) + ": FOK filled ahead of its own order trades in full");
+  }
+
+  return TestHarness::finish();
+}
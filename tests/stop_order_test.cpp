@@ -0,0 +1,113 @@
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// Stops wait off the book until a trade prints at or through their trigger, then enter as day orders (market,
+// or limited for a stop-limit) in trigger order; a trade a triggered stop makes can trigger further stops.
+
+namespace {
+  using TestHarness::expect;
+
+  constexpr ClientId SELLER = 2;
+  constexpr ClientId STOP_OWNER = 3;
+  constexpr ClientId BUYER = 4;
+  constexpr ClientId SECOND_STOP_OWNER = 5;
+
+  struct Published {
+    std::vector<MarketData> trades;
+    std::vector<MarketData> triggered;
+  };
+
+  Published sort(const std::vector<MarketData>& records) {
+    Published published;
+    for (const auto& data : records) {
+      if (data.type == MarketData::Type::TRADE) {
+        published.trades.push_back(data);
+      } else if (data.type == MarketData::Type::ADD && data.message == "Triggered") {
+        published.triggered.push_back(data);
+      }
+    }
+    return published;
+  }
+
+  Qty tradedBy(const Published& published, ClientId clientId, Price price) {
+    Qty quantity = 0;
+    for (const auto& trade : published.trades) {
+      quantity += trade.aggressiveClientId == clientId && trade.price == price ? trade.quantity : 0;
+    }
+    return quantity;
+  }
+
+  void buyStopTriggersAtItsPrice() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(SELLER, 1, Side::SELL, 101, 5);
+    book.addOrder(SELLER, 2, Side::SELL, 102, 5);
+    book.addOrder(SELLER, 3, Side::SELL, 103, 10);
+    const auto stop = book.addStopOrder(STOP_OWNER, 1, Side::BUY, 102, 0, 5);
+    TestHarness::drain(queue);
+
+    book.addOrder(BUYER, 1, Side::BUY, 101, 5);
+    auto published = sort(TestHarness::drain(queue));
+    expect(published.triggered.empty() && book.holds(stop), "a trade at 101 leaves a stop at 102 parked");
+
+    book.addOrder(BUYER, 2, Side::BUY, 102, 1);
+    published = sort(TestHarness::drain(queue));
+    expect(published.triggered.size() == 1 && published.triggered.front().aggressiveClientId == STOP_OWNER,
+           "a trade at 102 triggers it");
+    expect(tradedBy(published, STOP_OWNER, 102) == 4 && tradedBy(published, STOP_OWNER, 103) == 1,
+           "the triggered stop buys at market: 4 at 102, then 1 at 103");
+    expect(!book.holds(stop), "and leaves the book filled");
+  }
+
+  void sellStopLimitRestsAtItsLimit() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(BUYER, 1, Side::BUY, 99, 3);
+    const auto stop = book.addStopOrder(STOP_OWNER, 1, Side::SELL, 99, 100, 5);
+    book.addOrder(SELLER, 1, Side::SELL, 99, 3);
+    const auto published = sort(TestHarness::drain(queue));
+    expect(published.triggered.size() == 1, "a trade at 99 triggers the sell stop at 99");
+    expect(tradedBy(published, STOP_OWNER, 99) == 0 && book.holds(stop), "above the bid, its limit of 100 rests");
+  }
+
+  void triggeredStopsCascade() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(SELLER, 1, Side::SELL, 100, 1);
+    book.addOrder(SELLER, 2, Side::SELL, 105, 5);
+    // The first stop's fill at 105 is what triggers the second.
+    book.addStopOrder(SECOND_STOP_OWNER, 1, Side::BUY, 105, 0, 1);
+    book.addStopOrder(STOP_OWNER, 1, Side::BUY, 100, 0, 1);
+    TestHarness::drain(queue);
+
+    book.addOrder(BUYER, 1, Side::BUY, 100, 1);
+    const auto published = sort(TestHarness::drain(queue));
+    expect(published.triggered.size() == 2 && published.triggered[0].aggressiveClientId == STOP_OWNER &&
+           published.triggered[1].aggressiveClientId == SECOND_STOP_OWNER, "stops fire in trigger order, one setting off the next");
+    expect(tradedBy(published, STOP_OWNER, 105) == 1 && tradedBy(published, SECOND_STOP_OWNER, 105) == 1,
+           "each buys 1 at 105");
+  }
+
+  void cancelledStopNeverTriggers() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(SELLER, 1, Side::SELL, 100, 5);
+    const auto stop = book.addStopOrder(STOP_OWNER, 1, Side::BUY, 100, 0, 1);
+    expect(book.cancelOrder(STOP_OWNER, 1, stop), "a parked stop can be cancelled");
+    TestHarness::drain(queue);
+
+    book.addOrder(BUYER, 1, Side::BUY, 100, 1);
+    const auto published = sort(TestHarness::drain(queue));
+    expect(published.triggered.empty() && published.trades.size() == 1, "a trade at its trigger then sets nothing off");
+  }
+}
+
+int main() {
+  buyStopTriggersAtItsPrice();
+  sellStopLimitRestsAtItsLimit();
+  triggeredStopsCascade();
+  cancelledStopNeverTriggers();
+  return TestHarness::finish();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "market_publisher/market_data.h"
+
+// Shared by the tests: expect() reports and counts failed checks, and main returns finish().
+
+namespace TestHarness {
+  inline int failures = 0;
+
+  inline void expect(bool condition, const std::string& what) {
+    if (!condition) {
+      std::printf("FAILED: %s\n", what.c_str());
+      ++failures;
+    }
+  }
+
+  inline int finish() {
+    if (failures == 0) {
+      std::printf("all passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+  }
+
+  /// Everything published so far, in order.
+  inline std::vector<MarketData> drain(moodycamel::ConcurrentQueue<MarketData>& queue) {
+    std::vector<MarketData> records;
+    MarketData data;
+    while (queue.try_dequeue(data)) {
+      records.push_back(std::move(data));
+    }
+    return records;
+  }
+}
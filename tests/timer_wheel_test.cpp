@@ -0,0 +1,117 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "timer_wheel.h"
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// The timer wheel fires every timer exactly once, at its expiry tick (or the next tick for one already due),
+// however many levels it cascades through and however the clock is advanced. The book's side of good-till-date
+// expiry: an expired order is cancelled as Expired, and a handle that has gone stale expires nothing.
+
+namespace {
+  using TestHarness::expect;
+  using Wheel = TimerWheel<uint32_t>;
+
+  struct Timer {
+    uint64_t dueTick = 0;
+    uint64_t firedTick = 0;
+    int fired = 0;
+  };
+
+  void firesAtExpiryAcrossLevels() {
+    Wheel wheel;
+    // Expiries on every level, at slot boundaries and just either side of them, and past the top wheel.
+    const uint64_t expiries[] = {1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 262145,
+                                 Wheel::SPAN - 1, Wheel::SPAN, Wheel::SPAN + 5, 3 * Wheel::SPAN + 7};
+    std::vector<Timer> timers;
+    for (const auto expiry : expiries) {
+      wheel.schedule(expiry, static_cast<uint32_t>(timers.size()));
+      timers.push_back({expiry});
+    }
+    wheel.advance(4 * Wheel::SPAN, [&](uint32_t id) {
+      timers[id].firedTick = wheel.now();
+      ++timers[id].fired;
+    });
+    bool exact = true;
+    for (const auto& timer : timers) {
+      exact &= timer.fired == 1 && timer.firedTick == timer.dueTick;
+    }
+    expect(exact, "each timer fires once, at its own tick, in one long advance");
+    expect(wheel.empty(), "nothing is left pending");
+  }
+
+  void randomScheduleAndAdvance() {
+    Wheel wheel;
+    std::mt19937_64 random(7);
+    std::vector<Timer> timers;
+    auto expired = [&](uint32_t id) {
+      timers[id].firedTick = wheel.now();
+      ++timers[id].fired;
+      // A callback may schedule: every tenth timer re-arms a short one.
+      if (id % 10 == 0 && timers.size() < 20000) {
+        const auto due = wheel.now() + 1 + random() % 100;
+        wheel.schedule(due, static_cast<uint32_t>(timers.size()));
+        timers.push_back({due});
+      }
+    };
+    for (int round = 0; round < 2000; ++round) {
+      // Spans from a few ticks to beyond the wheel, including expiries already due.
+      const unsigned bits = static_cast<unsigned>(random() % 33);
+      const uint64_t offset = random() & ((uint64_t{1} << bits) - 1);
+      const bool alreadyDue = random() % 20 == 0;
+      const uint64_t due = alreadyDue ? wheel.now() - random() % (wheel.now() + 1) : wheel.now() + offset;
+      wheel.schedule(due, static_cast<uint32_t>(timers.size()));
+      timers.push_back({std::max(due, wheel.now() + 1)});
+      if (round % 3 == 0) {
+        wheel.advance(wheel.now() + random() % (uint64_t{1} << (random() % 24)), expired);
+      }
+    }
+    wheel.advance(wheel.now() + 4 * Wheel::SPAN, expired);
+
+    bool exact = true;
+    for (const auto& timer : timers) {
+      exact &= timer.fired == 1 && timer.firedTick == timer.dueTick;
+    }
+    expect(exact, "randomly scheduled timers each fire once, at their tick");
+    expect(wheel.empty(), "the wheel drains");
+  }
+
+  void neverEarly() {
+    Wheel wheel;
+    int fired = 0;
+    wheel.schedule(5000, 0);
+    wheel.advance(4999, [&](uint32_t) { ++fired; });
+    expect(fired == 0 && wheel.size() == 1, "a timer does not fire a tick early");
+    wheel.advance(5000, [&](uint32_t) { ++fired; });
+    expect(fired == 1, "it fires on its tick");
+  }
+
+  void bookExpiresGoodTillDate() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    const auto handle = book.addOrder(1, 1, Side::BUY, 100, 5, TimeInForce::DAY);
+    TestHarness::drain(queue);
+    expect(book.expireGoodTillDate(handle), "a resting GTD order expires");
+    bool cancelled = false;
+    for (const auto& data : TestHarness::drain(queue)) {
+      cancelled |= data.type == MarketData::Type::CANCEL && data.message == "Expired";
+    }
+    expect(cancelled && !book.holds(handle), "it is cancelled as Expired and leaves the book");
+
+    const auto filled = book.addOrder(1, 2, Side::BUY, 100, 5, TimeInForce::DAY);
+    book.addOrder(2, 1, Side::SELL, 100, 5);
+    TestHarness::drain(queue);
+    expect(!book.expireGoodTillDate(filled) && TestHarness::drain(queue).empty(),
+           "an order that filled before its expiry expires nothing");
+  }
+}
+
+int main() {
+  firesAtExpiryAcrossLevels();
+  randomScheduleAndAdvance();
+  neverEarly();
+  bookExpiresGoodTillDate();
+  return TestHarness::finish();
+}
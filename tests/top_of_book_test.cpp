@@ -0,0 +1,86 @@
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "test_harness.h"
+
+// Each inbound order publishes at most one top-of-book update per side, after its trades, however many
+// fills and levels it went through, and none for a side whose best price and size did not move.
+
+namespace {
+  using TestHarness::expect;
+
+  std::vector<MarketData> updatesIn(const std::vector<MarketData>& records) {
+    std::vector<MarketData> updates;
+    for (const auto& data : records) {
+      if (data.type == MarketData::Type::BOOK_UPDATE) {
+        updates.push_back(data);
+      }
+    }
+    return updates;
+  }
+
+  void sweepPublishesOncePerSide() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    OrderId nextClientOrderId = 1;
+    for (Price price = 100; price <= 103; ++price) {
+      book.addOrder(2, nextClientOrderId++, Side::SELL, price, 5);
+      book.addOrder(3, nextClientOrderId++, Side::SELL, price, 5);
+    }
+    TestHarness::drain(queue);
+
+    // Takes all of 100 to 102 and rests 4 at 102.
+    book.addOrder(1, nextClientOrderId, Side::BUY, 102, 34);
+    const auto published = TestHarness::drain(queue);
+    const auto updates = updatesIn(published);
+    std::size_t trades = 0;
+    for (const auto& data : published) {
+      trades += data.type == MarketData::Type::TRADE;
+    }
+    expect(trades == 6, "the sweep trades with all six orders at 100 to 102");
+    expect(updates.size() == 2, "the sweep publishes one update per side");
+    for (const auto& update : updates) {
+      expect(update.side == 'B' ? update.price == 102 && update.quantity == 4 : update.price == 103 && update.quantity == 10,
+             std::string("the ") + update.side + " update shows where the sweep left the side");
+    }
+    expect(!published.empty() && published.back().type == MarketData::Type::BOOK_UPDATE,
+           "the updates follow the trades");
+  }
+
+  void partialFillAtTheTouch() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(2, 1, Side::SELL, 100, 5);
+    book.addOrder(3, 2, Side::SELL, 100, 5);
+    TestHarness::drain(queue);
+
+    // Two fills at the same level still move the offer once, from 10 to 3.
+    book.addOrder(1, 3, Side::BUY, 100, 7);
+    const auto updates = updatesIn(TestHarness::drain(queue));
+    expect(updates.size() == 1 && updates.front().side == 'S' && updates.front().price == 100 &&
+           updates.front().quantity == 3, "a fill across two orders publishes the offer once, as 3 at 100");
+  }
+
+  void unmovedSideIsNotPublished() {
+    moodycamel::ConcurrentQueue<MarketData> queue(256);
+    OrderBook book(1, &queue, 64);
+    book.addOrder(1, 1, Side::BUY, 100, 5);
+    book.addOrder(2, 2, Side::SELL, 102, 5);
+    TestHarness::drain(queue);
+
+    book.addOrder(1, 3, Side::BUY, 99, 5);
+    expect(updatesIn(TestHarness::drain(queue)).empty(), "an order behind the touch publishes no update");
+
+    book.addOrder(1, 4, Side::BUY, 100, 5);
+    const auto updates = updatesIn(TestHarness::drain(queue));
+    expect(updates.size() == 1 && updates.front().side == 'B' && updates.front().quantity == 10,
+           "joining the best bid updates only the bid");
+  }
+}
+
+int main() {
+  sweepPublishesOncePerSide();
+  partialFillAtTheTouch();
+  unmovedSideIsNotPublished();
+  return TestHarness::finish();
+}